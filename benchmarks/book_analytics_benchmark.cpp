@@ -0,0 +1,104 @@
+#include "book_analytics.hpp"
+#include "tsc_clock.hpp"
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <memory>
+using namespace std;
+
+namespace
+{
+    const size_t kInstruments = 200;
+    const size_t kUpdates = 200000;
+
+    void fillBook(OrderBookAnalytics &book, size_t depth, mt19937_64 &rng)
+    {
+        uniform_real_distribution<double> size(1.0, 500.0);
+        for (size_t i = 0; i < depth; ++i)
+        {
+            book.setLevel(BookSide::Bid, i, 50000.0 - 0.5 * i, size(rng));
+            book.setLevel(BookSide::Ask, i, 50000.5 + 0.5 * i, size(rng));
+        }
+        book.refresh();
+    }
+
+    double computeSignals(OrderBookAnalytics &book)
+    {
+        return book.vwap(BookSide::Ask, 2500.0) + book.vwap(BookSide::Bid, 2500.0) +
+               book.sweepCost(BookSide::Ask, 1000.0) + book.microprice() +
+               book.imbalance(5) + book.weightedImbalance(10, 0.8) +
+               double(book.levelsToFill(BookSide::Ask, 2500.0));
+    }
+
+    // Returns nanoseconds per instrument update
+    double run(size_t depth, bool incremental, double &checksum)
+    {
+        mt19937_64 rng(42);
+        vector<unique_ptr<OrderBookAnalytics>> books;
+        for (size_t i = 0; i < kInstruments; ++i)
+        {
+            books.push_back(make_unique<OrderBookAnalytics>(depth));
+            fillBook(*books.back(), depth, rng);
+        }
+
+        // Most real updates touch the top of book, so changes are skewed towards level 0
+        geometric_distribution<size_t> levelPick(depth >= 100 ? 0.1 : 0.3);
+        uniform_real_distribution<double> size(1.0, 500.0);
+        vector<size_t> levels(kUpdates);
+        vector<double> sizes(kUpdates);
+        for (size_t i = 0; i < kUpdates; ++i)
+        {
+            levels[i] = min(levelPick(rng), depth - 1);
+            sizes[i] = size(rng);
+        }
+
+        checksum = 0.0;
+        auto start = TscClock::now();
+        for (size_t i = 0; i < kUpdates; ++i)
+        {
+            auto &book = *books[i % kInstruments];
+            BookSide side = (i & 1) ? BookSide::Ask : BookSide::Bid;
+            double price = side == BookSide::Bid ? 50000.0 - 0.5 * levels[i] : 50000.5 + 0.5 * levels[i];
+            book.setLevel(side, levels[i], price, sizes[i]);
+            if (!incremental)
+            {
+                book.markAllDirty();
+            }
+            book.refresh();
+            checksum += computeSignals(book);
+        }
+        auto elapsed = TscClock::nowOrdered() - start;
+        return TscClock::toNanoseconds(elapsed) / kUpdates;
+    }
+}
+
+int main()
+{
+    cout << "=== Order Book Analytics Benchmark ===\n"
+         << "AVX2 available: " << (BookKernels::usingAvx2() ? "yes" : "no") << "\n"
+         << kInstruments << " instruments, " << kUpdates << " updates, ns per instrument update\n\n";
+
+    cout << setw(8) << "Depth" << setw(16) << "Scalar full" << setw(16) << "SIMD full"
+         << setw(18) << "Scalar incr." << setw(16) << "SIMD incr." << "\n";
+
+    for (size_t depth : {10, 100, 1000})
+    {
+        double scalarSum, simdSum, ignored;
+        BookKernels::forceScalar(true);
+        double scalarFull = run(depth, false, scalarSum);
+        double scalarIncremental = run(depth, true, ignored);
+        BookKernels::forceScalar(false);
+        double simdFull = run(depth, false, simdSum);
+        double simdIncremental = run(depth, true, ignored);
+
+        cout << fixed << setprecision(1)
+             << setw(8) << depth << setw(16) << scalarFull << setw(16) << simdFull
+             << setw(18) << scalarIncremental << setw(16) << simdIncremental;
+        if (abs(scalarSum - simdSum) > 1e-6 * abs(scalarSum))
+        {
+            cout << "  (scalar/SIMD mismatch: " << scalarSum << " vs " << simdSum << ")";
+        }
+        cout << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "option_pricer.hpp"
+#include "tsc_clock.hpp"
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <random>
+using namespace std;
+
+namespace
+{
+    const int64_t kAsOfMs = 1767225600000LL; // 2026-01-01 00:00 UTC
+    const int kExpiries = 24;
+    const int kStrikesPerExpiry = 200;
+    const int kRepetitions = 200;
+
+    OptionChain syntheticChain()
+    {
+        OptionChain chain;
+        mt19937_64 rng(7);
+        uniform_real_distribution<double> volNoise(-0.05, 0.05);
+        const double spot = 90000.0;
+
+        chain.reserve(size_t(kExpiries) * kStrikesPerExpiry * 2);
+        for (int e = 0; e < kExpiries; ++e)
+        {
+            int64_t expiryMs = kAsOfMs + int64_t(1 + e * e) * 86400000LL * 3;
+            for (int k = 0; k < kStrikesPerExpiry; ++k)
+            {
+                double strike = spot * (0.3 + 1.7 * k / kStrikesPerExpiry);
+                double vol = 0.45 + 0.3 * pow(log(strike / spot), 2) + volNoise(rng);
+                chain.add("SYN-C", expiryMs, strike, true, spot, 0.0, vol, kAsOfMs);
+                chain.add("SYN-P", expiryMs, strike, false, spot, 0.0, vol, kAsOfMs);
+            }
+        }
+        return chain;
+    }
+
+    double timeRevalue(OptionPricingEngine &engine, OptionChain &chain, ChainGreeks &greeks)
+    {
+        engine.revalue(chain, 0.0, greeks);
+        auto start = TscClock::now();
+        for (int i = 0; i < kRepetitions; ++i)
+        {
+            chain.rescaleUnderlying(i & 1 ? 1.0001 : 1.0 / 1.0001);
+            engine.revalue(chain, 0.0, greeks);
+        }
+        return TscClock::toNanoseconds(TscClock::nowOrdered() - start) / kRepetitions / 1000.0;
+    }
+
+    double timeImpliedVols(OptionPricingEngine &engine, const OptionChain &chain,
+                           const vector<double> &targets, vector<double> &vols)
+    {
+        const int repetitions = kRepetitions / 10;
+        auto start = TscClock::now();
+        for (int i = 0; i < repetitions; ++i)
+        {
+            engine.impliedVols(chain, targets.data(), 0.0, vols);
+        }
+        return TscClock::toNanoseconds(TscClock::nowOrdered() - start) / repetitions / 1000.0;
+    }
+}
+
+int main()
+{
+    OptionChain chain = syntheticChain();
+    cout << "=== Option Chain Benchmark ===\n"
+         << chain.size() << " options, AVX2 available: " << (OptionPricingEngine::usingAvx2() ? "yes" : "no")
+         << ", hardware threads: " << thread::hardware_concurrency() << "\n\n";
+
+    ChainGreeks reference;
+    OptionPricingEngine::forceScalar(true);
+    OptionPricingEngine(1).revalue(chain, 0.0, reference);
+    OptionPricingEngine::forceScalar(false);
+
+    cout << setw(10) << "Kernel" << setw(10) << "Threads" << setw(18) << "Revalue (us)"
+         << setw(18) << "Implied vol (us)" << setw(16) << "Max vol error" << "\n";
+
+    for (bool scalar : {true, false})
+    {
+        OptionPricingEngine::forceScalar(scalar);
+        for (size_t threads : {size_t(1), size_t(thread::hardware_concurrency())})
+        {
+            OptionPricingEngine engine(threads);
+            ChainGreeks greeks;
+            OptionChain working = chain;
+            double revalueUs = timeRevalue(engine, working, greeks);
+
+            vector<double> vols;
+            double ivUs = timeImpliedVols(engine, chain, reference.prices, vols);
+            // Far wings with almost no vega do not pin down a vol; leave them out
+            double maxError = 0.0;
+            for (size_t i = 0; i < chain.size(); ++i)
+            {
+                if (!isnan(vols[i]) && reference.vegas[i] >= 0.01)
+                {
+                    maxError = max(maxError, fabs(vols[i] - chain.markVols[i]));
+                }
+            }
+
+            cout << setw(10) << (scalar ? "scalar" : "avx2") << setw(10) << threads
+                 << fixed << setprecision(1) << setw(18) << revalueUs << setw(18) << ivUs
+                 << scientific << setprecision(2) << setw(16) << maxError << "\n";
+        }
+    }
+
+    ChainGreeks simd;
+    OptionPricingEngine(1).revalue(chain, 0.0, simd);
+    double maxPriceDiff = 0.0;
+    for (size_t i = 0; i < chain.size(); ++i)
+    {
+        maxPriceDiff = max(maxPriceDiff, fabs(simd.prices[i] - reference.prices[i]));
+    }
+    cout << "\nMax scalar/SIMD price difference: " << maxPriceDiff << " USD\n";
+    return 0;
+}
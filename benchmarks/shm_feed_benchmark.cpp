@@ -0,0 +1,168 @@
+#include "shm_feed.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+using namespace std;
+
+namespace
+{
+    const char *kSegmentName = "/deribit_feed_benchmark";
+
+    struct ReaderResult
+    {
+        uint64_t received;
+        uint64_t lapped;
+        uint64_t missed;
+        int64_t p50Ns;
+        int64_t p99Ns;
+        int64_t p999Ns;
+        int64_t maxNs;
+    };
+
+    int64_t monotonicNanoseconds()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return int64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+    }
+
+    int64_t percentile(const vector<int64_t> &sorted, double fraction)
+    {
+        return sorted.empty() ? 0 : sorted[min(sorted.size() - 1, size_t(fraction * sorted.size()))];
+    }
+
+    // Child process: attach, report ready, consume until the publisher goes away
+    ReaderResult runReader(int readyFd, size_t expected)
+    {
+        ShmFeedReader reader(kSegmentName);
+        char ready = 1;
+        (void)!write(readyFd, &ready, 1);
+
+        vector<int64_t> latencies;
+        latencies.reserve(expected);
+        FeedRecord record;
+        int idlePolls = 0;
+        for (;;)
+        {
+            // Sampled before polling so an empty poll after the publisher left means fully drained
+            bool active = reader.producerActive();
+            FeedReadResult result = reader.poll(record);
+            if (result == FeedReadResult::Record)
+            {
+                latencies.push_back(monotonicNanoseconds() - record.publishMonotonicNs);
+                idlePolls = 0;
+            }
+            else if (result == FeedReadResult::Empty)
+            {
+                if (!active)
+                {
+                    break;
+                }
+                // Spin first, then let the publisher run on machines with few cores
+                if (++idlePolls > 64)
+                {
+                    this_thread::yield();
+                }
+            }
+        }
+
+        sort(latencies.begin(), latencies.end());
+        return ReaderResult{latencies.size(), reader.lappedCount(), reader.missedRecords(),
+                            percentile(latencies, 0.50), percentile(latencies, 0.99),
+                            percentile(latencies, 0.999), latencies.empty() ? 0 : latencies.back()};
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t readers = argc > 1 ? size_t(atoi(argv[1])) : 8;
+    size_t records = argc > 2 ? size_t(atol(argv[2])) : 1000000;
+    int64_t intervalNs = argc > 3 ? atol(argv[3]) : 2000;
+
+    cout << "=== Shared Memory Feed Benchmark ===\n"
+         << readers << " reader processes, " << records << " records, one every " << intervalNs
+         << " ns, hardware threads: " << thread::hardware_concurrency() << "\n\n";
+
+    auto publisher = make_unique<ShmFeedPublisher>(kSegmentName, 65536);
+
+    int readyPipe[2];
+    int resultPipe[2];
+    if (pipe(readyPipe) != 0 || pipe(resultPipe) != 0)
+    {
+        cerr << "pipe failed\n";
+        return 1;
+    }
+
+    vector<pid_t> children;
+    for (size_t i = 0; i < readers; ++i)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            ReaderResult result = runReader(readyPipe[1], records);
+            (void)!write(resultPipe[1], &result, sizeof(result));
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+
+    for (size_t i = 0; i < readers; ++i)
+    {
+        char ready;
+        (void)!read(readyPipe[0], &ready, 1);
+    }
+
+    FeedRecord record{};
+    snprintf(record.instrument, sizeof(record.instrument), "BTC-PERPETUAL");
+    record.type = FeedRecordType::BookUpdate;
+    record.lastFragment = true;
+    record.bidCount = 5;
+    record.askCount = 5;
+    for (size_t level = 0; level < 10; ++level)
+    {
+        record.levels[level] = {90000.0 + (level < 5 ? -0.5 : 0.5) * double(level + 1), 1000.0};
+    }
+
+    int64_t start = monotonicNanoseconds();
+    int64_t next = start;
+    for (size_t i = 0; i < records; ++i)
+    {
+        while (monotonicNanoseconds() < next)
+        {
+        }
+        record.changeId = int64_t(i);
+        publisher->publish(record);
+        next += intervalNs;
+    }
+    double publishSeconds = double(monotonicNanoseconds() - start) / 1e9;
+    publisher.reset();
+
+    cout << setw(8) << "Reader" << setw(12) << "Received" << setw(10) << "Lapped" << setw(12) << "Missed"
+         << setw(10) << "p50 ns" << setw(10) << "p99 ns" << setw(12) << "p99.9 ns" << setw(12) << "max ns" << "\n";
+    for (size_t i = 0; i < readers; ++i)
+    {
+        ReaderResult result;
+        if (read(resultPipe[0], &result, sizeof(result)) != sizeof(result))
+        {
+            cerr << "reader result missing\n";
+            continue;
+        }
+        cout << setw(8) << i << setw(12) << result.received << setw(10) << result.lapped
+             << setw(12) << result.missed << setw(10) << result.p50Ns << setw(10) << result.p99Ns
+             << setw(12) << result.p999Ns << setw(12) << result.maxNs << "\n";
+    }
+    for (pid_t pid : children)
+    {
+        waitpid(pid, nullptr, 0);
+    }
+
+    cout << "\nPublished " << fixed << setprecision(0) << double(records) / publishSeconds << " records/s\n";
+    return 0;
+}
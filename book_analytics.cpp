@@ -0,0 +1,359 @@
+#include "book_analytics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BOOK_ANALYTICS_AVX2 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+using namespace std;
+
+namespace
+{
+    constexpr size_t kClean = numeric_limits<size_t>::max();
+    const double kNaN = numeric_limits<double>::quiet_NaN();
+
+    void multiplyScalar(const double *a, const double *b, double *out, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = a[i] * b[i];
+        }
+    }
+
+    double prefixSumScalar(const double *in, double *out, size_t count, double carry)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            carry += in[i];
+            out[i] = carry;
+        }
+        return carry;
+    }
+
+    double dotScalar(const double *a, const double *b, size_t count)
+    {
+        double sum = 0.0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+#ifdef BOOK_ANALYTICS_AVX2
+    AVX2_TARGET void multiplyAvx2(const double *a, const double *b, double *out, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        }
+        multiplyScalar(a + i, b + i, out + i, count - i);
+    }
+
+    // In-register scan: two shift-and-add steps give the running sum of four
+    // lanes, then the previous block's total is broadcast and added.
+    AVX2_TARGET double prefixSumAvx2(const double *in, double *out, size_t count, double carry)
+    {
+        const __m256d zero = _mm256_setzero_pd();
+        __m256d running = _mm256_set1_pd(carry);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m256d x = _mm256_loadu_pd(in + i);
+            __m256d shifted = _mm256_blend_pd(_mm256_permute4x64_pd(x, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x1);
+            x = _mm256_add_pd(x, shifted);
+            x = _mm256_add_pd(x, _mm256_permute2f128_pd(x, x, 0x08));
+            x = _mm256_add_pd(x, running);
+            _mm256_storeu_pd(out + i, x);
+            running = _mm256_permute4x64_pd(x, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+        return prefixSumScalar(in + i, out + i, count - i, _mm256_cvtsd_f64(running));
+    }
+
+    AVX2_TARGET double dotAvx2(const double *a, const double *b, size_t count)
+    {
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+            sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+        }
+        __m256d sum = _mm256_add_pd(sum0, sum1);
+        __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+        double total = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        return total + dotScalar(a + i, b + i, count - i);
+    }
+
+    bool cpuHasAvx2()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#else
+    bool cpuHasAvx2()
+    {
+        return false;
+    }
+#endif
+
+    const bool avx2Supported = cpuHasAvx2();
+}
+
+bool BookKernels::scalarOnly = false;
+
+bool BookKernels::usingAvx2()
+{
+    return avx2Supported && !scalarOnly;
+}
+
+void BookKernels::forceScalar(bool enable)
+{
+    scalarOnly = enable;
+}
+
+void BookKernels::multiply(const double *a, const double *b, double *out, size_t count)
+{
+#ifdef BOOK_ANALYTICS_AVX2
+    if (usingAvx2())
+    {
+        multiplyAvx2(a, b, out, count);
+        return;
+    }
+#endif
+    multiplyScalar(a, b, out, count);
+}
+
+double BookKernels::prefixSum(const double *in, double *out, size_t count, double carry)
+{
+#ifdef BOOK_ANALYTICS_AVX2
+    if (usingAvx2())
+    {
+        return prefixSumAvx2(in, out, count, carry);
+    }
+#endif
+    return prefixSumScalar(in, out, count, carry);
+}
+
+double BookKernels::dot(const double *a, const double *b, size_t count)
+{
+#ifdef BOOK_ANALYTICS_AVX2
+    if (usingAvx2())
+    {
+        return dotAvx2(a, b, count);
+    }
+#endif
+    return dotScalar(a, b, count);
+}
+
+OrderBookAnalytics::OrderBookAnalytics(size_t maxDepth)
+    : capacity(maxDepth)
+{
+    for (auto *columns : {&bids, &asks})
+    {
+        columns->prices.assign(capacity, 0.0);
+        columns->amounts.assign(capacity, 0.0);
+        columns->notionals.assign(capacity, 0.0);
+        columns->cumulativeAmounts.assign(capacity, 0.0);
+        columns->cumulativeNotionals.assign(capacity, 0.0);
+        columns->dirtyFrom = kClean;
+    }
+}
+
+void OrderBookAnalytics::setLevel(BookSide side, size_t index, double price, double amount)
+{
+    auto &columns = sideOf(side);
+    if (index > columns.count || index >= capacity)
+    {
+        throw out_of_range("Book level " + to_string(index) + " is past the end of the book");
+    }
+
+    columns.prices[index] = price;
+    columns.amounts[index] = amount;
+    if (index == columns.count)
+    {
+        columns.count++;
+    }
+    markDirty(columns, index, index + 1);
+}
+
+void OrderBookAnalytics::assign(BookSide side, const double *prices, const double *amounts, size_t count)
+{
+    auto &columns = sideOf(side);
+    count = min(count, capacity);
+
+    // Only the span that actually differs is marked, so a snapshot feed that
+    // repeats an unchanged top of book costs a compare, not a recompute.
+    size_t first = 0;
+    size_t common = min(count, columns.count);
+    while (first < common && columns.prices[first] == prices[first] && columns.amounts[first] == amounts[first])
+    {
+        ++first;
+    }
+    size_t last = count;
+    while (last > first && last <= common &&
+           columns.prices[last - 1] == prices[last - 1] && columns.amounts[last - 1] == amounts[last - 1])
+    {
+        --last;
+    }
+
+    copy(prices + first, prices + last, columns.prices.begin() + first);
+    copy(amounts + first, amounts + last, columns.amounts.begin() + first);
+    columns.count = count;
+    if (first < last)
+    {
+        markDirty(columns, first, last);
+    }
+}
+
+void OrderBookAnalytics::truncate(BookSide side, size_t count)
+{
+    auto &columns = sideOf(side);
+    columns.count = min(columns.count, count);
+}
+
+void OrderBookAnalytics::markAllDirty()
+{
+    markDirty(bids, 0, bids.count);
+    markDirty(asks, 0, asks.count);
+}
+
+void OrderBookAnalytics::refresh()
+{
+    refreshSide(bids);
+    refreshSide(asks);
+}
+
+void OrderBookAnalytics::markDirty(SideColumns &columns, size_t from, size_t to)
+{
+    columns.dirtyFrom = min(columns.dirtyFrom, from);
+    columns.dirtyTo = max(columns.dirtyTo, to);
+}
+
+void OrderBookAnalytics::refreshSide(SideColumns &columns)
+{
+    if (columns.dirtyFrom == kClean)
+    {
+        return;
+    }
+
+    size_t from = columns.dirtyFrom;
+    size_t to = min(columns.dirtyTo, columns.count);
+    columns.dirtyFrom = kClean;
+    columns.dirtyTo = 0;
+    if (from >= columns.count)
+    {
+        return;
+    }
+
+    BookKernels::multiply(columns.prices.data() + from, columns.amounts.data() + from,
+                          columns.notionals.data() + from, to - from);
+
+    double amountCarry = from > 0 ? columns.cumulativeAmounts[from - 1] : 0.0;
+    double notionalCarry = from > 0 ? columns.cumulativeNotionals[from - 1] : 0.0;
+    size_t tail = columns.count - from;
+    BookKernels::prefixSum(columns.amounts.data() + from, columns.cumulativeAmounts.data() + from, tail, amountCarry);
+    BookKernels::prefixSum(columns.notionals.data() + from, columns.cumulativeNotionals.data() + from, tail, notionalCarry);
+}
+
+double OrderBookAnalytics::bestPrice(BookSide side) const
+{
+    const auto &columns = sideOf(side);
+    return columns.count > 0 ? columns.prices[0] : kNaN;
+}
+
+size_t OrderBookAnalytics::fillIndex(const SideColumns &columns, double size) const
+{
+    auto begin = columns.cumulativeAmounts.begin();
+    return static_cast<size_t>(lower_bound(begin, begin + columns.count, size) - begin);
+}
+
+double OrderBookAnalytics::sweepCost(BookSide side, double contracts) const
+{
+    const auto &columns = sideOf(side);
+    if (contracts <= 0.0)
+    {
+        return 0.0;
+    }
+
+    size_t index = fillIndex(columns, contracts);
+    if (index >= columns.count)
+    {
+        return kNaN;
+    }
+
+    double filledBefore = index > 0 ? columns.cumulativeAmounts[index - 1] : 0.0;
+    double notionalBefore = index > 0 ? columns.cumulativeNotionals[index - 1] : 0.0;
+    return notionalBefore + (contracts - filledBefore) * columns.prices[index];
+}
+
+double OrderBookAnalytics::vwap(BookSide side, double size) const
+{
+    if (size <= 0.0)
+    {
+        return bestPrice(side);
+    }
+    return sweepCost(side, size) / size;
+}
+
+size_t OrderBookAnalytics::levelsToFill(BookSide side, double size) const
+{
+    const auto &columns = sideOf(side);
+    size_t index = fillIndex(columns, size);
+    return index < columns.count ? index + 1 : 0;
+}
+
+double OrderBookAnalytics::microprice() const
+{
+    if (bids.count == 0 || asks.count == 0)
+    {
+        return kNaN;
+    }
+
+    double bidSize = bids.amounts[0];
+    double askSize = asks.amounts[0];
+    double total = bidSize + askSize;
+    if (total <= 0.0)
+    {
+        return (bids.prices[0] + asks.prices[0]) / 2.0;
+    }
+    return (bids.prices[0] * askSize + asks.prices[0] * bidSize) / total;
+}
+
+double OrderBookAnalytics::imbalance(size_t levels) const
+{
+    size_t bidLevels = min(levels, bids.count);
+    size_t askLevels = min(levels, asks.count);
+    double bidSize = bidLevels > 0 ? bids.cumulativeAmounts[bidLevels - 1] : 0.0;
+    double askSize = askLevels > 0 ? asks.cumulativeAmounts[askLevels - 1] : 0.0;
+    double total = bidSize + askSize;
+    return total > 0.0 ? (bidSize - askSize) / total : 0.0;
+}
+
+double OrderBookAnalytics::weightedImbalance(size_t levels, double decay)
+{
+    levels = min(levels, capacity);
+    if (weights.size() < levels || weightsDecay != decay)
+    {
+        weights.resize(max(levels, weights.size()));
+        double weight = 1.0;
+        for (auto &w : weights)
+        {
+            w = weight;
+            weight *= decay;
+        }
+        weightsDecay = decay;
+    }
+
+    double bidSize = BookKernels::dot(bids.amounts.data(), weights.data(), min(levels, bids.count));
+    double askSize = BookKernels::dot(asks.amounts.data(), weights.data(), min(levels, asks.count));
+    double total = bidSize + askSize;
+    return total > 0.0 ? (bidSize - askSize) / total : 0.0;
+}
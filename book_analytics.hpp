@@ -0,0 +1,87 @@
+#ifndef BOOK_ANALYTICS_HPP
+#define BOOK_ANALYTICS_HPP
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+enum class BookSide
+{
+    Bid,
+    Ask
+};
+
+// Column kernels used by OrderBookAnalytics. AVX2 versions are selected at
+// runtime when the CPU supports them; the scalar versions are the reference.
+class BookKernels
+{
+public:
+    static void multiply(const double *a, const double *b, double *out, size_t count);
+    static double prefixSum(const double *in, double *out, size_t count, double carry);
+    static double dot(const double *a, const double *b, size_t count);
+
+    static bool usingAvx2();
+    static void forceScalar(bool scalarOnly);
+
+private:
+    static bool scalarOnly;
+};
+
+// Order book held as struct-of-arrays columns, index 0 being the best level.
+// Level writes only mark the book dirty; refresh() recomputes notionals for
+// the changed levels and the running totals from the first changed level on,
+// after which every query is O(1) or a binary search.
+class OrderBookAnalytics
+{
+public:
+    explicit OrderBookAnalytics(size_t maxDepth = 1000);
+
+    void setLevel(BookSide side, size_t index, double price, double amount);
+    void assign(BookSide side, const double *prices, const double *amounts, size_t count);
+    void truncate(BookSide side, size_t count);
+    void markAllDirty();
+    void refresh();
+
+    size_t depth(BookSide side) const { return sideOf(side).count; }
+    double bestPrice(BookSide side) const;
+
+    // Average fill price for taking `size` from a side; NaN if the book is too thin
+    double vwap(BookSide side, double size) const;
+    // Total notional paid or received for taking `contracts` from a side; NaN if too thin
+    double sweepCost(BookSide side, double contracts) const;
+    // Number of levels needed to fill `size`, or 0 if the book is too thin
+    size_t levelsToFill(BookSide side, double size) const;
+    double microprice() const;
+    // (bid size - ask size) / (bid size + ask size) over the top `levels`
+    double imbalance(size_t levels) const;
+    // Same, with level i weighted by decay^i
+    double weightedImbalance(size_t levels, double decay);
+
+private:
+    struct SideColumns
+    {
+        vector<double> prices;
+        vector<double> amounts;
+        vector<double> notionals;
+        vector<double> cumulativeAmounts;
+        vector<double> cumulativeNotionals;
+        size_t count = 0;
+        size_t dirtyFrom = 0;
+        size_t dirtyTo = 0; // exclusive bound of levels whose notional changed
+    };
+
+    size_t capacity;
+    SideColumns bids;
+    SideColumns asks;
+    vector<double> weights;
+    double weightsDecay = 0.0;
+
+    SideColumns &sideOf(BookSide side) { return side == BookSide::Bid ? bids : asks; }
+    const SideColumns &sideOf(BookSide side) const { return side == BookSide::Bid ? bids : asks; }
+    void markDirty(SideColumns &columns, size_t from, size_t to);
+    void refreshSide(SideColumns &columns);
+    size_t fillIndex(const SideColumns &columns, double size) const;
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "instrumentation.hpp"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+using namespace std;
+
+struct Instrumentation::Registry
+{
+    mutex registryMutex;
+    vector<string> names;
+    unordered_map<string, MetricId> ids;
+    vector<unique_ptr<Cell[]>> threads;
+};
+
+thread_local Instrumentation::Cell *Instrumentation::threadCells = nullptr;
+
+Instrumentation::Registry &Instrumentation::registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+MetricId Instrumentation::intern(string_view name)
+{
+    return intern(string_view(), name);
+}
+
+MetricId Instrumentation::intern(string_view prefix, string_view name)
+{
+    // The key buffer keeps its capacity, so cache hits do not allocate
+    thread_local unordered_map<string, MetricId> cache;
+    thread_local string key;
+    key.assign(prefix).append(name);
+
+    auto cached = cache.find(key);
+    if (cached != cache.end())
+    {
+        return cached->second;
+    }
+
+    auto &shared = registry();
+    lock_guard<mutex> lock(shared.registryMutex);
+    auto it = shared.ids.find(key);
+    if (it == shared.ids.end())
+    {
+        // The last id is shared by every name past the limit
+        MetricId id = MetricId(min(shared.names.size(), kMaxMetrics - 1));
+        if (id == shared.names.size())
+        {
+            shared.names.push_back(id == kMaxMetrics - 1 ? "Other metrics" : key);
+        }
+        it = shared.ids.emplace(key, id).first;
+    }
+    cache.emplace(key, it->second);
+    return it->second;
+}
+
+bool Instrumentation::find(string_view name, MetricId &id)
+{
+    auto &shared = registry();
+    lock_guard<mutex> lock(shared.registryMutex);
+    auto it = shared.ids.find(string(name));
+    if (it == shared.ids.end())
+    {
+        return false;
+    }
+    id = it->second;
+    return true;
+}
+
+Instrumentation::Cell *Instrumentation::registerThread()
+{
+    auto &shared = registry();
+    lock_guard<mutex> lock(shared.registryMutex);
+    shared.threads.emplace_back(new Cell[kMaxMetrics]);
+    threadCells = shared.threads.back().get();
+    return threadCells;
+}
+
+MetricStats Instrumentation::stats(MetricId id)
+{
+    auto &shared = registry();
+    lock_guard<mutex> lock(shared.registryMutex);
+
+    MetricStats result;
+    if (id < shared.names.size())
+    {
+        result.name = shared.names[id];
+    }
+    for (const auto &cells : shared.threads)
+    {
+        const Cell &cell = cells[id];
+        result.count += cell.count.load(memory_order_relaxed);
+        result.total += cell.total.load(memory_order_relaxed);
+        result.min = min(result.min, cell.min.load(memory_order_relaxed));
+        result.max = max(result.max, cell.max.load(memory_order_relaxed));
+    }
+    return result;
+}
+
+vector<MetricStats> Instrumentation::snapshot()
+{
+    size_t count;
+    {
+        auto &shared = registry();
+        lock_guard<mutex> lock(shared.registryMutex);
+        count = shared.names.size();
+    }
+
+    vector<MetricStats> result;
+    for (MetricId id = 0; id < count; ++id)
+    {
+        MetricStats metric = stats(id);
+        if (metric.count > 0)
+        {
+            result.push_back(move(metric));
+        }
+    }
+    return result;
+}
+
+void Instrumentation::reset()
+{
+    auto &shared = registry();
+    lock_guard<mutex> lock(shared.registryMutex);
+    for (const auto &cells : shared.threads)
+    {
+        for (size_t id = 0; id < kMaxMetrics; ++id)
+        {
+            clearCell(cells[id]);
+        }
+    }
+}
+
+void Instrumentation::reset(MetricId id)
+{
+    auto &shared = registry();
+    lock_guard<mutex> lock(shared.registryMutex);
+    for (const auto &cells : shared.threads)
+    {
+        clearCell(cells[id]);
+    }
+}
+
+void Instrumentation::clearCell(Cell &cell)
+{
+    cell.count.store(0, memory_order_relaxed);
+    cell.total.store(0, memory_order_relaxed);
+    cell.min.store(numeric_limits<TscClock::ticks>::max(), memory_order_relaxed);
+    cell.max.store(0, memory_order_relaxed);
+}
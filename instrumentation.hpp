@@ -0,0 +1,122 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include "tsc_clock.hpp"
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+using MetricId = uint32_t;
+
+struct MetricStats
+{
+    string name;
+    uint64_t count = 0;
+    TscClock::ticks total = 0;
+    TscClock::ticks min = numeric_limits<TscClock::ticks>::max();
+    TscClock::ticks max = 0;
+
+    double averageMilliseconds() const { return count > 0 ? TscClock::toMilliseconds(total) / count : 0.0; }
+};
+
+// Timing registry behind LatencyTracker and PerformanceMonitor. Names are
+// interned to small ids once (per call site with DERIBIT_METRIC, or through a
+// per-thread cache for names built at run time). Each thread records into its
+// own cells without locks or read-modify-write instructions; readers sum the
+// cells of every thread that ever recorded.
+class Instrumentation
+{
+public:
+    static constexpr size_t kMaxMetrics = 256;
+
+    static MetricId intern(string_view name);
+    static MetricId intern(string_view prefix, string_view name);
+    // Does not create the metric; returns false if it was never interned
+    static bool find(string_view name, MetricId &id);
+
+    static void record(MetricId id, TscClock::ticks elapsed)
+    {
+        Cell &cell = localCells()[id];
+        auto relaxed = memory_order_relaxed;
+        cell.count.store(cell.count.load(relaxed) + 1, relaxed);
+        cell.total.store(cell.total.load(relaxed) + elapsed, relaxed);
+        if (elapsed < cell.min.load(relaxed))
+        {
+            cell.min.store(elapsed, relaxed);
+        }
+        if (elapsed > cell.max.load(relaxed))
+        {
+            cell.max.store(elapsed, relaxed);
+        }
+    }
+
+    static MetricStats stats(MetricId id);
+    // Metrics with at least one sample, in interning order
+    static vector<MetricStats> snapshot();
+    // Threads recording concurrently may keep part of their last sample
+    static void reset();
+    static void reset(MetricId id);
+
+private:
+    // Single writer per cell, so plain load/store pairs are enough
+    struct Cell
+    {
+        atomic<uint64_t> count{0};
+        atomic<TscClock::ticks> total{0};
+        atomic<TscClock::ticks> min{numeric_limits<TscClock::ticks>::max()};
+        atomic<TscClock::ticks> max{0};
+    };
+
+    struct Registry;
+
+    static thread_local Cell *threadCells;
+    static Registry &registry();
+
+    static Cell *localCells()
+    {
+        return threadCells ? threadCells : registerThread();
+    }
+    static Cell *registerThread();
+    static void clearCell(Cell &cell);
+};
+
+// Times the enclosing scope
+class ScopedSpan
+{
+public:
+    explicit ScopedSpan(MetricId id) : id(id), start(TscClock::now()) {}
+    ~ScopedSpan() { Instrumentation::record(id, TscClock::nowOrdered() - start); }
+
+    ScopedSpan(const ScopedSpan &) = delete;
+    ScopedSpan &operator=(const ScopedSpan &) = delete;
+
+private:
+    MetricId id;
+    TscClock::ticks start;
+};
+
+// Configuring with -DDERIBIT_INSTRUMENTATION=OFF defines
+// DERIBIT_DISABLE_INSTRUMENTATION and every probe below expands to nothing,
+// arguments included.
+#define DERIBIT_CONCAT_INNER(a, b) a##b
+#define DERIBIT_CONCAT(a, b) DERIBIT_CONCAT_INNER(a, b)
+
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
+#define DERIBIT_METRIC(name) ([]() -> MetricId { static const MetricId id = Instrumentation::intern(name); return id; }())
+#define DERIBIT_SPAN(name) ScopedSpan DERIBIT_CONCAT(deribitSpan, __LINE__)(DERIBIT_METRIC(name))
+#define DERIBIT_SPAN_DYNAMIC(prefix, name) \
+    ScopedSpan DERIBIT_CONCAT(deribitSpan, __LINE__)(Instrumentation::intern(prefix, name))
+#define DERIBIT_RECORD(name, elapsed) Instrumentation::record(DERIBIT_METRIC(name), elapsed)
+#else
+#define DERIBIT_METRIC(name) MetricId(0)
+#define DERIBIT_SPAN(name) static_cast<void>(0)
+#define DERIBIT_SPAN_DYNAMIC(prefix, name) static_cast<void>(0)
+#define DERIBIT_RECORD(name, elapsed) static_cast<void>(0)
+#endif
+
+#endif
@@ -1,81 +1,81 @@
 #include "latency_tracker.hpp"
 #include <iostream>
-#include <algorithm>
-#include <numeric>
 using namespace std;
 
-vector<LatencyTracker::LatencyRecord> LatencyTracker::latencyHistory;
-mutex LatencyTracker::historyMutex;
 bool LatencyTracker::detailedLogging = true;
-map<string, LatencyTracker::OperationStats> LatencyTracker::operationStats;
 
-chrono::high_resolution_clock::time_point LatencyTracker::startMeasurement(const string &operationType)
+TscClock::ticks LatencyTracker::startMeasurement(const string &operationType)
 {
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
     if (!operationType.empty() && detailedLogging)
     {
         cout << "\n=== Starting " << operationType << " ===\n";
     }
-    return chrono::high_resolution_clock::now();
+    return TscClock::now();
+#else
+    (void)operationType;
+    return 0;
+#endif
 }
 
-void LatencyTracker::endMeasurement(const chrono::high_resolution_clock::time_point &startTime,
+void LatencyTracker::endMeasurement(const TscClock::ticks &startTime,
                                     const string &operationName)
 {
-    auto endTime = chrono::high_resolution_clock::now();
-    chrono::duration<double> duration = endTime - startTime;
-    double milliseconds = duration.count() * 1000.0;
-
-    recordLatency(operationName, milliseconds);
-    updateStats(operationName, milliseconds);
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
+    endMeasurement(startTime, Instrumentation::intern(operationName));
+#else
+    (void)startTime;
+    (void)operationName;
+#endif
+}
 
-    cout << "\n=== Latency Metrics ===\n";
-    cout << operationName << ":\n";
-    cout << "  Current: " << fixed << setprecision(2) << milliseconds << " ms\n";
+void LatencyTracker::endMeasurement(const TscClock::ticks &startTime, MetricId metric)
+{
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
+    TscClock::ticks elapsed = TscClock::nowOrdered() - startTime;
+    Instrumentation::record(metric, elapsed);
 
-    lock_guard<mutex> lock(historyMutex);
-    auto it = operationStats.find(operationName);
-    if (it != operationStats.end())
+    if (detailedLogging)
     {
-        const auto &stats = it->second;
-        cout << "  Average: " << stats.total / stats.count << " ms\n";
-        cout << "  Min: " << stats.min << " ms\n";
-        cout << "  Max: " << stats.max << " ms\n";
-        cout << "  Sample Count: " << stats.count << "\n";
+        MetricStats stats = Instrumentation::stats(metric);
+        cout << "\n=== Latency Metrics ===\n";
+        cout << stats.name << ":\n";
+        cout << "  Current: " << fixed << setprecision(2) << TscClock::toMilliseconds(elapsed) << " ms\n";
+        printStats(stats);
     }
+#else
+    (void)startTime;
+    (void)metric;
+#endif
 }
 
 void LatencyTracker::displayLatencyStats()
 {
-    lock_guard<mutex> lock(historyMutex);
+    TscClock::recalibrateIfDue();
+
     cout << "\n=== Overall Latency Statistics ===\n";
-    for (const auto &[operation, stats] : operationStats)
+    for (const auto &stats : Instrumentation::snapshot())
     {
         cout << "\n"
-             << operation << ":\n";
-        cout << "  Average: " << fixed << setprecision(2) << stats.total / stats.count << " ms\n";
-        cout << "  Min: " << stats.min << " ms\n";
-        cout << "  Max: " << stats.max << " ms\n";
-        cout << "  Sample Count: " << stats.count << "\n";
+             << stats.name << ":\n"
+             << fixed << setprecision(2);
+        printStats(stats);
     }
 }
 
 double LatencyTracker::getAverageLatency(const string &operationType)
 {
-    lock_guard<mutex> lock(historyMutex);
-    auto it = operationStats.find(operationType);
-    if (it != operationStats.end())
+    MetricId metric;
+    if (!Instrumentation::find(operationType, metric))
     {
-        const auto &stats = it->second;
-        return stats.count > 0 ? stats.total / stats.count : 0.0;
+        return 0.0;
     }
-    return 0.0;
+    return Instrumentation::stats(metric).averageMilliseconds();
 }
 
 void LatencyTracker::resetStatistics()
 {
-    lock_guard<mutex> lock(historyMutex);
-    latencyHistory.clear();
-    operationStats.clear();
+    Instrumentation::reset();
 }
 
 void LatencyTracker::enableDetailedLogging(bool enable)
@@ -83,43 +83,22 @@ void LatencyTracker::enableDetailedLogging(bool enable)
     detailedLogging = enable;
 }
 
-void LatencyTracker::recordLatency(const string &operation, double duration)
-{
-    lock_guard<mutex> lock(historyMutex);
-
-    LatencyRecord record{
-        operation,
-        duration,
-        chrono::system_clock::now()};
-
-    latencyHistory.push_back(record);
-
-    if (latencyHistory.size() > 1000)
-    {
-        latencyHistory.erase(latencyHistory.begin());
-    }
-}
-
-void LatencyTracker::updateStats(const string &operation, double duration)
+void LatencyTracker::printStats(const MetricStats &stats)
 {
-    lock_guard<mutex> lock(historyMutex);
-
-    auto &stats = operationStats[operation];
-    stats.min = min(stats.min, duration);
-    stats.max = max(stats.max, duration);
-    stats.total += duration;
-    stats.count++;
+    cout << "  Average: " << stats.averageMilliseconds() << " ms\n";
+    cout << "  Min: " << TscClock::toMilliseconds(stats.min) << " ms\n";
+    cout << "  Max: " << TscClock::toMilliseconds(stats.max) << " ms\n";
+    cout << "  Sample Count: " << stats.count << "\n";
 }
 
 map<string, double> LatencyTracker::getLatencyAverages()
 {
-    lock_guard<mutex> lock(historyMutex);
-    map<string, double> averages;
+    TscClock::recalibrateIfDue();
 
-    for (const auto &[operation, stats] : operationStats)
+    map<string, double> averages;
+    for (const auto &stats : Instrumentation::snapshot())
     {
-        averages[operation] = stats.count > 0 ? stats.total / stats.count : 0.0;
+        averages[stats.name] = stats.averageMilliseconds();
     }
-
     return averages;
 }
@@ -2,7 +2,12 @@
 #include "network_client.hpp"
 #include "market_operations.hpp"
 #include "latency_tracker.hpp"
+#include "trade_tracer.hpp"
+#include "strategy_host.hpp"
+#include "tick_store.hpp"
+#include "shm_feed.hpp"
 #include <iostream>
+#include <csignal>
 #include <memory>
 #include <future>
 #include <unordered_map>
@@ -23,6 +28,121 @@ void displayFinalStats()
 {
     cout << "\n=== Final System Performance Statistics ===\n";
     LatencyTracker::displayLatencyStats();
+    TradeTracer::displayTraceStats();
+}
+
+atomic<bool> hostRunning{true};
+
+void runStrategyHost(const vector<string> &strategyPaths)
+{
+    try
+    {
+        NetworkClient websocket("test.deribit.com", "443", "/ws/api/v2");
+        websocket.establishConnection();
+
+        auto trading = make_unique<MarketOperations>(websocket);
+        trading->login(API_KEY, API_SECRET);
+        websocket.enableMessageLogging(false);
+
+        StrategyHost host(*trading);
+        for (const auto &path : strategyPaths)
+        {
+            host.loadStrategy(path);
+            cout << "Loaded strategy " << path << endl;
+        }
+
+        signal(SIGINT, [](int)
+               { hostRunning = false; });
+        host.run(hostRunning);
+        host.stop();
+
+        websocket.disconnect();
+    }
+    catch (const exception &e)
+    {
+        cerr << "Fatal strategy host error: " << e.what() << endl;
+    }
+}
+
+void runTickCapture(const string &directory, const vector<string> &instruments)
+{
+    try
+    {
+        NetworkClient websocket("test.deribit.com", "443", "/ws/api/v2");
+        websocket.establishConnection();
+
+        auto trading = make_unique<MarketOperations>(websocket);
+        trading->login(API_KEY, API_SECRET);
+        websocket.enableMessageLogging(false);
+
+        TickStore store(directory);
+        vector<string> channels;
+        for (const auto &instrument : instruments)
+        {
+            channels.push_back(SubscriptionManager::bookChannel(instrument, ChannelInterval::Raw));
+            channels.push_back(SubscriptionManager::tradesChannel(instrument, ChannelInterval::Raw));
+            channels.push_back(SubscriptionManager::tickerChannel(instrument, ChannelInterval::Raw));
+        }
+        SubscriptionId capture = trading->subscriptionManager().subscribe(
+            channels, [&store](const json &params)
+            { store.captureNotification(params); });
+        cout << "Capturing " << instruments.size() << " instruments into " << directory << endl;
+
+        signal(SIGINT, [](int)
+               { hostRunning = false; });
+        while (hostRunning)
+        {
+            trading->pollMarketData();
+        }
+        trading->subscriptionManager().unsubscribe(capture);
+        store.close();
+
+        websocket.disconnect();
+    }
+    catch (const exception &e)
+    {
+        cerr << "Fatal capture error: " << e.what() << endl;
+    }
+}
+
+void runFeedHandler(const string &segment, const vector<string> &instruments)
+{
+    try
+    {
+        NetworkClient websocket("test.deribit.com", "443", "/ws/api/v2");
+        websocket.establishConnection();
+
+        auto trading = make_unique<MarketOperations>(websocket);
+        trading->login(API_KEY, API_SECRET);
+        websocket.enableMessageLogging(false);
+
+        ShmFeedPublisher feed(segment);
+        vector<string> channels;
+        for (const auto &instrument : instruments)
+        {
+            channels.push_back(SubscriptionManager::bookChannel(instrument, ChannelInterval::Raw));
+            channels.push_back(SubscriptionManager::tickerChannel(instrument, ChannelInterval::Raw));
+        }
+        SubscriptionId publishing = trading->subscriptionManager().subscribe(
+            channels, [&feed](const json &params)
+            { feed.publishNotification(params); });
+        cout << "Publishing " << instruments.size() << " instruments to " << feed.name() << endl;
+
+        signal(SIGINT, [](int)
+               { hostRunning = false; });
+        while (hostRunning)
+        {
+            trading->pollMarketData(chrono::milliseconds(100));
+            feed.publishDueSnapshots();
+        }
+        trading->subscriptionManager().unsubscribe(publishing);
+
+        websocket.disconnect();
+    }
+    catch (const exception &e)
+    {
+        cerr << "Fatal feed handler error: " << e.what() << endl;
+    }
 }
 
 void runTradingSystem()
@@ -226,6 +346,10 @@ void runTradingSystem()
             LatencyTracker::endMeasurement(operation_start, "Total Operation Time");
         }
 
+        auto cache = trading->cacheStats();
+        cout << "\nRequest cache: " << cache.hits << " hits, " << cache.misses << " misses, "
+             << cache.coalesced << " coalesced, " << cache.subscriptionHits << " served from subscriptions\n";
+
         websocket.disconnect();
     }
     catch (const exception &e)
@@ -234,12 +358,27 @@ void runTradingSystem()
     }
 }
 
-int main()
+int main(int argc, char *argv[])
 {
     try
     {
         cout << "Starting Deribit Trading System...\n";
-        runTradingSystem();
+        if (argc > 2 && string(argv[1]) == "--strategy")
+        {
+            runStrategyHost(vector<string>(argv + 2, argv + argc));
+        }
+        else if (argc > 3 && string(argv[1]) == "--capture")
+        {
+            runTickCapture(argv[2], vector<string>(argv + 3, argv + argc));
+        }
+        else if (argc > 3 && string(argv[1]) == "--feed")
+        {
+            runFeedHandler(argv[2], vector<string>(argv + 3, argv + argc));
+        }
+        else
+        {
+            runTradingSystem();
+        }
         displayFinalStats();
 
         return 0;
@@ -1,12 +1,52 @@
 #include "market_operations.hpp"
-#include "latency_tracker.hpp"
+#include "instrumentation.hpp"
+#include "trade_tracer.hpp"
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 using namespace std;
 
 atomic<int> MarketOperations::messageCounter{1};
 
+namespace
+{
+    // Ends the trace of the frame being dispatched, however dispatch exits
+    struct FrameScope
+    {
+        ~FrameScope() { TradeTracer::endFrame(); }
+    };
+
+    // requestMutex locks this thread holds. A thread holding one must not
+    // wait on another thread's cached fetch, which needs the mutex to finish.
+    thread_local int heldRequestLocks = 0;
+
+    class RequestLock
+    {
+    public:
+        explicit RequestLock(recursive_mutex &requestMutex) : lock(requestMutex) { heldRequestLocks++; }
+        ~RequestLock() { heldRequestLocks--; }
+
+        RequestLock(const RequestLock &) = delete;
+        RequestLock &operator=(const RequestLock &) = delete;
+
+    private:
+        lock_guard<recursive_mutex> lock;
+    };
+}
+
 MarketOperations::MarketOperations(NetworkClient &client)
-    : network(client) {}
+    : network(client),
+      subscriptions([this](const string &method, const json &params)
+                    { return sendMethod(method, params); }),
+      cacheTtls{{"public/get_order_book", chrono::milliseconds(100)},
+                {"private/get_positions", chrono::milliseconds(500)},
+                {"public/get_book_summary_by_currency", chrono::milliseconds(1000)}}
+{
+    subscriptions.setObserver([this](const json &params)
+                              { observeNotification(params); });
+    subscriptions.setResetObserver([this](const vector<string> &channels)
+                                   { resetBooks(channels); });
+}
 
 int MarketOperations::getNextMessageId()
 {
@@ -33,6 +73,8 @@ json MarketOperations::login(const string &key, const string &secret)
 
 json MarketOperations::submitOrder(const string &symbol, double size, double price)
 {
+    TradeTracer::stamp(TraceStage::Decision);
+
     try
     {
         json request = {
@@ -40,6 +82,7 @@ json MarketOperations::submitOrder(const string &symbol, double size, double pri
             {"id", getNextMessageId()},
             {"method", "private/buy"},
             {"params", {{"instrument_name", symbol}, {"amount", size}, {"type", "limit"}, {"price", price}}}};
+        cache.invalidate("private/get_positions");
         return sendRequest(request);
     }
     catch (const exception &e)
@@ -51,6 +94,8 @@ json MarketOperations::submitOrder(const string &symbol, double size, double pri
 
 json MarketOperations::removeOrder(const string &orderId)
 {
+    TradeTracer::stamp(TraceStage::Decision);
+
     try
     {
         json request = {
@@ -58,6 +103,7 @@ json MarketOperations::removeOrder(const string &orderId)
             {"id", getNextMessageId()},
             {"method", "private/cancel"},
             {"params", {{"order_id", orderId}}}};
+        cache.invalidate("private/get_positions");
         return sendRequest(request);
     }
     catch (const exception &e)
@@ -69,6 +115,8 @@ json MarketOperations::removeOrder(const string &orderId)
 
 json MarketOperations::adjustOrder(const string &orderId, double newPrice, double newSize)
 {
+    TradeTracer::stamp(TraceStage::Decision);
+
     try
     {
         json request = {
@@ -76,6 +124,7 @@ json MarketOperations::adjustOrder(const string &orderId, double newPrice, doubl
             {"id", getNextMessageId()},
             {"method", "private/edit"},
             {"params", {{"order_id", orderId}, {"price", newPrice}, {"amount", newSize}, {"post_only", true}}}};
+        cache.invalidate("private/get_positions");
         return sendRequest(request);
     }
     catch (const exception &e)
@@ -89,12 +138,12 @@ json MarketOperations::fetchMarketDepth(const string &symbol)
 {
     try
     {
-        json request = {
-            {"jsonrpc", "2.0"},
-            {"id", getNextMessageId()},
-            {"method", "public/get_order_book"},
-            {"params", {{"instrument_name", symbol}, {"depth", 10}}}};
-        return sendRequest(request);
+        json response;
+        if (depthFromSubscription(symbol, 10, response))
+        {
+            return response;
+        }
+        return sendCached("public/get_order_book", {{"instrument_name", symbol}, {"depth", 10}});
     }
     catch (const exception &e)
     {
@@ -103,16 +152,11 @@ json MarketOperations::fetchMarketDepth(const string &symbol)
     }
 }
 
-json MarketOperations::getActivePositions()
+json MarketOperations::getActivePositions(const string &kind)
 {
     try
     {
-        json request = {
-            {"jsonrpc", "2.0"},
-            {"id", getNextMessageId()},
-            {"method", "private/get_positions"},
-            {"params", {{"kind", "future"}}}};
-        return sendRequest(request);
+        return sendCached("private/get_positions", {{"kind", kind}});
     }
     catch (const exception &e)
     {
@@ -121,19 +165,77 @@ json MarketOperations::getActivePositions()
     }
 }
 
+json MarketOperations::fetchBookSummaryByCurrency(const string &currency, const string &kind)
+{
+    try
+    {
+        return sendCached("public/get_book_summary_by_currency", {{"currency", currency}, {"kind", kind}});
+    }
+    catch (const exception &e)
+    {
+        handleError("Book summary fetch failed: " + string(e.what()));
+        throw;
+    }
+}
+
+void MarketOperations::setCacheTtl(const string &method, chrono::milliseconds ttl)
+{
+    cacheTtls[method] = ttl;
+}
+
+void MarketOperations::useSubscriptionBooks(bool enable)
+{
+    subscriptionBooksEnabled = enable;
+}
+
+int MarketOperations::submitOrderAsync(const string &symbol, OrderSide side, double size, double price,
+                                       const string &label, ResponseHandler onResponse)
+{
+    TradeTracer::stamp(TraceStage::Decision);
+
+    json params = {{"instrument_name", symbol}, {"amount", size}, {"type", "limit"}, {"price", price}};
+    if (!label.empty())
+    {
+        params["label"] = label;
+    }
+    return sendAsync(side == OrderSide::Buy ? "private/buy" : "private/sell", params, move(onResponse));
+}
+
+int MarketOperations::adjustOrderAsync(const string &orderId, double newPrice, double newSize,
+                                       ResponseHandler onResponse)
+{
+    TradeTracer::stamp(TraceStage::Decision);
+    return sendAsync("private/edit",
+                     {{"order_id", orderId}, {"price", newPrice}, {"amount", newSize}, {"post_only", true}},
+                     move(onResponse));
+}
+
+int MarketOperations::removeOrderAsync(const string &orderId, ResponseHandler onResponse)
+{
+    TradeTracer::stamp(TraceStage::Decision);
+    return sendAsync("private/cancel", {{"order_id", orderId}}, move(onResponse));
+}
+
 void MarketOperations::registerMarketDataCallback(const string &symbol,
-                                                  function<void(const json &)> callback)
+                                                  function<void(const json &)> callback,
+                                                  ChannelInterval interval)
 {
-    dataHandlers[symbol] = callback;
+    registerMarketDataCallbacks({symbol}, move(callback), interval);
+}
 
+void MarketOperations::registerMarketDataCallbacks(const vector<string> &symbols,
+                                                   function<void(const json &)> callback,
+                                                   ChannelInterval interval)
+{
     try
     {
-        json subscription = {
-            {"jsonrpc", "2.0"},
-            {"id", getNextMessageId()},
-            {"method", "public/subscribe"},
-            {"params", {{"channels", {"book." + symbol + ".100ms"}}}}};
-        sendRequest(subscription);
+        vector<string> channels;
+        channels.reserve(symbols.size());
+        for (const auto &symbol : symbols)
+        {
+            channels.push_back(SubscriptionManager::bookChannel(symbol, interval));
+        }
+        subscriptions.subscribe(channels, move(callback));
     }
     catch (const exception &e)
     {
@@ -142,28 +244,263 @@ void MarketOperations::registerMarketDataCallback(const string &symbol,
     }
 }
 
-json MarketOperations::sendRequest(const json &request)
+void MarketOperations::pollMarketData()
 {
-    string operation = "Unknown";
-    if (request.contains("method"))
+    RequestLock lock(requestMutex);
+    FrameScope frame;
+    dispatchMessage(network.receiveData());
+}
+
+bool MarketOperations::pollMarketData(chrono::milliseconds timeout)
+{
+    RequestLock lock(requestMutex);
+    FrameScope frame;
+    json message;
+    if (!network.receiveData(message, timeout))
     {
-        operation = request["method"].get<string>();
+        return false;
     }
+    dispatchMessage(move(message));
+    return true;
+}
 
-    auto latencyStart = LatencyTracker::startMeasurement("API Call: " + operation);
+json MarketOperations::sendCached(const string &method, const json &params)
+{
+    auto ttl = cacheTtls.find(method);
+    return cache.getOrFetch(method + params.dump(),
+                            ttl != cacheTtls.end() ? ttl->second : chrono::milliseconds(0),
+                            [&]
+                            { return sendMethod(method, params); },
+                            heldRequestLocks == 0);
+}
 
-    // Network send timing
-    auto sendStart = LatencyTracker::startMeasurement("Network Send");
-    network.transmitData(request);
-    LatencyTracker::endMeasurement(sendStart, "Network Send Time");
+bool MarketOperations::depthFromSubscription(const string &symbol, size_t depth, json &response)
+{
+    if (!subscriptionBooksEnabled)
+    {
+        return false;
+    }
 
-    // Network receive timing
-    auto receiveStart = LatencyTracker::startMeasurement("Network Receive");
-    json response = network.receiveData();
-    LatencyTracker::endMeasurement(receiveStart, "Network Receive Time");
+    vector<pair<string, json>> candidates;
+    {
+        lock_guard<mutex> lock(bookMutex);
+        auto books = subscribedBooks.find(symbol);
+        if (books == subscribedBooks.end())
+        {
+            return false;
+        }
+        for (const auto &[channel, book] : books->second)
+        {
+            if (book.valid() && book.depthLimit() >= depth)
+            {
+                candidates.emplace_back(channel, book.depthResult(depth));
+            }
+        }
+    }
 
-    // Total API call time
-    LatencyTracker::endMeasurement(latencyStart, "Total API Call Time: " + operation);
+    // A book is only trusted while its channel is still subscribed
+    for (auto &[channel, result] : candidates)
+    {
+        if (subscriptions.isSubscribed(channel))
+        {
+            response = {{"jsonrpc", "2.0"}, {"result", move(result)}};
+            cache.countSubscriptionHit();
+            return true;
+        }
+    }
+    return false;
+}
+
+void MarketOperations::observeNotification(const json &params)
+{
+    const string &channel = params["channel"].get_ref<const string &>();
+    if (channel.rfind("user.trades", 0) == 0)
+    {
+        cache.invalidate("private/get_positions");
+        return;
+    }
+    if (channel.rfind("book.", 0) != 0 || !params.contains("data"))
+    {
+        return;
+    }
+
+    // book.<instrument>.<interval> or book.<instrument>.<group>.<depth>.<interval>;
+    // price-grouped books do not match get_order_book and are skipped
+    vector<string> parts;
+    size_t start = 0;
+    for (size_t dot = channel.find('.'); dot != string::npos; dot = channel.find('.', start))
+    {
+        parts.push_back(channel.substr(start, dot - start));
+        start = dot + 1;
+    }
+    parts.push_back(channel.substr(start));
+
+    size_t depthLimit;
+    if (parts.size() == 3)
+    {
+        depthLimit = numeric_limits<size_t>::max();
+    }
+    else if (parts.size() == 5 && parts[2] == "none")
+    {
+        depthLimit = size_t(atoi(parts[3].c_str()));
+    }
+    else
+    {
+        return;
+    }
+
+    lock_guard<mutex> lock(bookMutex);
+    auto &books = subscribedBooks[parts[1]];
+    auto book = books.try_emplace(channel, depthLimit).first;
+    book->second.apply(params["data"]);
+}
+
+void MarketOperations::resetBooks(const vector<string> &channels)
+{
+    lock_guard<mutex> lock(bookMutex);
+    for (auto &[instrument, books] : subscribedBooks)
+    {
+        for (const auto &channel : channels)
+        {
+            books.erase(channel);
+        }
+    }
+}
+
+json MarketOperations::sendMethod(const string &method, const json &params)
+{
+    json request = {
+        {"jsonrpc", "2.0"},
+        {"id", getNextMessageId()},
+        {"method", method},
+        {"params", params}};
+    return sendRequest(request);
+}
+
+int MarketOperations::sendAsync(const string &method, const json &params, ResponseHandler onResponse)
+{
+    int id = getNextMessageId();
+    json request = {
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"method", method},
+        {"params", params}};
+
+    if (method == "private/buy" || method == "private/sell" || method == "private/edit" ||
+        method == "private/cancel")
+    {
+        cache.invalidate("private/get_positions");
+    }
+
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        pendingResponses[id] = PendingResponse{move(onResponse), TraceContext{}};
+    }
+
+    // The read path writes too (pong and close frames), so the write shares
+    // the read's lock; from the reading thread's own callbacks this is free
+    RequestLock requestLock(requestMutex);
+    try
+    {
+        network.transmitData(request);
+    }
+    catch (const exception &e)
+    {
+        {
+            lock_guard<mutex> lock(pendingMutex);
+            pendingResponses.erase(id);
+        }
+        handleError("Async request " + method + " failed: " + string(e.what()));
+        throw;
+    }
+
+    // The trace is parked with the request and completed when the ack arrives
+    TraceContext trace = TradeTracer::takeCurrent();
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        auto it = pendingResponses.find(id);
+        if (it != pendingResponses.end())
+        {
+            it->second.trace = trace;
+        }
+    }
+    TradeTracer::resume(trace);
+    return id;
+}
+
+void MarketOperations::dispatchMessage(json message)
+{
+    if (message.contains("method") && message["method"] == "subscription" && message.contains("params"))
+    {
+        subscriptions.dispatch(move(message["params"]));
+        return;
+    }
+
+    if (message.contains("id") && message["id"].is_number_integer())
+    {
+        PendingResponse pending;
+        {
+            lock_guard<mutex> lock(pendingMutex);
+            auto it = pendingResponses.find(message["id"].get<int>());
+            if (it == pendingResponses.end())
+            {
+                return;
+            }
+            pending = move(it->second);
+            pendingResponses.erase(it);
+        }
+
+        if (pending.trace.has(TraceStage::Decision))
+        {
+            TradeTracer::stamp(pending.trace, TraceStage::ExchangeAck);
+            TradeTracer::complete(pending.trace);
+        }
+        if (pending.handler)
+        {
+            pending.handler(message);
+        }
+    }
+}
+
+json MarketOperations::sendRequest(const json &request)
+{
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
+    static const string unknownMethod = "Unknown";
+    const string &operation = request.contains("method") ? request["method"].get_ref<const string &>()
+                                                         : unknownMethod;
+#endif
+    RequestLock requestLock(requestMutex);
+    DERIBIT_SPAN_DYNAMIC("Total API Call Time: ", operation);
+
+    {
+        DERIBIT_SPAN("Network Send Time");
+        network.transmitData(request);
+    }
+
+    // Frames read while waiting start traces of their own
+    TraceContext trace = TradeTracer::takeCurrent();
+
+    // Notifications that arrive ahead of the response are dispatched, not mistaken for it
+    json response;
+    {
+        DERIBIT_SPAN("Network Receive Time");
+        response = network.receiveData();
+        while (!response.contains("id") || response["id"] != request["id"])
+        {
+            {
+                FrameScope frame;
+                dispatchMessage(move(response));
+            }
+            response = network.receiveData();
+        }
+    }
+
+    if (trace.has(TraceStage::Decision))
+    {
+        TradeTracer::stamp(trace, TraceStage::ExchangeAck);
+        TradeTracer::complete(trace);
+    }
+    TradeTracer::resume(trace);
 
     if (response.contains("error"))
     {
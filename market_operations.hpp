@@ -2,9 +2,17 @@
 #define MARKET_OPERATIONS_HPP
 
 #include "network_client.hpp"
+#include "subscription_manager.hpp"
+#include "trade_tracer.hpp"
+#include "order_types.hpp"
+#include "request_cache.hpp"
+#include "order_book.hpp"
 #include <nlohmann/json.hpp>
+#include <chrono>
 #include <functional>
 #include <map>
+#include <unordered_map>
+#include <mutex>
 #include <atomic>
 
 using namespace std;
@@ -20,17 +28,69 @@ public:
     json removeOrder(const string &orderId);
     json adjustOrder(const string &orderId, double newPrice, double newSize);
     json fetchMarketDepth(const string &symbol);
-    json getActivePositions();
+    json getActivePositions(const string &kind = "future");
+    json fetchBookSummaryByCurrency(const string &currency, const string &kind = "option");
 
-    void registerMarketDataCallback(const string &symbol, function<void(const json &)> callback);
+    // Fire-and-forget order entry: the request is written before returning and
+    // onResponse runs on whichever thread later reads the reply. Called from
+    // another thread than the reader, it waits for the read in progress.
+    using ResponseHandler = function<void(const json &)>;
+    int submitOrderAsync(const string &symbol, OrderSide side, double size, double price,
+                         const string &label, ResponseHandler onResponse);
+    int adjustOrderAsync(const string &orderId, double newPrice, double newSize, ResponseHandler onResponse);
+    int removeOrderAsync(const string &orderId, ResponseHandler onResponse);
+
+    void registerMarketDataCallback(const string &symbol, function<void(const json &)> callback,
+                                    ChannelInterval interval = ChannelInterval::Ms100);
+    void registerMarketDataCallbacks(const vector<string> &symbols, function<void(const json &)> callback,
+                                     ChannelInterval interval = ChannelInterval::Ms100);
+    void pollMarketData();
+    // Returns false if nothing arrived within timeout
+    bool pollMarketData(chrono::milliseconds timeout);
+
+    SubscriptionManager &subscriptionManager() { return subscriptions; }
+
+    // fetchMarketDepth, getActivePositions and fetchBookSummaryByCurrency go
+    // through a read-through cache. Identical calls in flight share one
+    // request even with a zero TTL. Configure before issuing requests.
+    void setCacheTtl(const string &method, chrono::milliseconds ttl);
+    // Answer fetchMarketDepth from a live book.* subscription when there is one
+    void useSubscriptionBooks(bool enable);
+    RequestCacheStats cacheStats() const { return cache.stats(); }
 
 private:
     NetworkClient &network;
-    map<string, function<void(const json &)>> dataHandlers;
+    SubscriptionManager subscriptions;
     static atomic<int> messageCounter;
 
+    struct PendingResponse
+    {
+        ResponseHandler handler;
+        TraceContext trace;
+    };
+    mutex pendingMutex;
+    unordered_map<int, PendingResponse> pendingResponses;
+
+    // Every socket read and write, and so one request/response exchange at a
+    // time; recursive because callbacks dispatched while waiting may issue
+    // requests of their own
+    recursive_mutex requestMutex;
+
+    RequestCache cache;
+    unordered_map<string, chrono::milliseconds> cacheTtls;
+    bool subscriptionBooksEnabled = true;
+    mutex bookMutex;
+    unordered_map<string, map<string, LocalOrderBook>> subscribedBooks; // instrument -> channel -> book
+
     int getNextMessageId();
     json sendRequest(const json &request);
+    json sendMethod(const string &method, const json &params);
+    int sendAsync(const string &method, const json &params, ResponseHandler onResponse);
+    json sendCached(const string &method, const json &params);
+    bool depthFromSubscription(const string &symbol, size_t depth, json &response);
+    void observeNotification(const json &params);
+    void resetBooks(const vector<string> &channels);
+    void dispatchMessage(json message);
     void handleError(const string &context);
 };
 
@@ -1,5 +1,6 @@
 #include "network_client.hpp"
 #include "performance_monitor.hpp"
+#include "trade_tracer.hpp"
 #include <iostream>
 using namespace std;
 
@@ -28,6 +29,10 @@ void NetworkClient::establishConnection()
 
         auto endpoints = resolver.resolve(host, "443");
         boost::asio::connect(ws.next_layer().next_layer(), endpoints);
+        if (!ws.next_layer().next_layer().enableKernelTimestamps())
+        {
+            cout << "Kernel receive timestamps unavailable, using user-space stamps" << endl;
+        }
 
         ws.next_layer().handshake(ssl::stream_base::client);
         ws.handshake(host, endpoint);
@@ -53,8 +58,13 @@ void NetworkClient::transmitData(const json &data)
         }
 
         string message = data.dump();
+        TradeTracer::stamp(TraceStage::Encode);
         ws.write(boost::asio::buffer(message));
-        cout << "Transmitted: " << message << endl;
+        TradeTracer::stamp(TraceStage::WireWrite);
+        if (logMessages)
+        {
+            cout << "Transmitted: " << message << endl;
+        }
     }
     catch (const exception &e)
     {
@@ -72,21 +82,79 @@ json NetworkClient::receiveData()
             throw runtime_error("Not connected to server");
         }
 
-        beast::flat_buffer buffer;
-        ws.read(buffer);
+        ws.read(readBuffer);
+        return decodeMessage();
+    }
+    catch (const exception &e)
+    {
+        logError("reception", e.what());
+        throw;
+    }
+}
 
-        string data = beast::buffers_to_string(buffer.data());
-        cout << "Received: " << data << endl;
+bool NetworkClient::receiveData(json &message, chrono::milliseconds timeout)
+{
+    auto &socket = ws.next_layer().next_layer();
+    try
+    {
+        if (!connected)
+        {
+            throw runtime_error("Not connected to server");
+        }
 
-        return json::parse(data);
+        socket.setReadDeadline(chrono::steady_clock::now() + timeout);
+        ws.read(readBuffer);
+        socket.setReadDeadline({});
+        message = decodeMessage();
+        return true;
+    }
+    catch (const SocketReadTimeout &)
+    {
+        socket.setReadDeadline({});
+        return false;
     }
     catch (const exception &e)
     {
+        socket.setReadDeadline({});
         logError("reception", e.what());
         throw;
     }
 }
 
+json NetworkClient::decodeMessage()
+{
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
+    receiveTicks = TscClock::now();
+    TradeTracer::beginFrame(receiveTicks, lastKernelReceiveNanoseconds());
+#endif
+
+    const char *begin = static_cast<const char *>(readBuffer.data().data());
+    const char *end = begin + readBuffer.size();
+    if (logMessages)
+    {
+        cout << "Received: " << string_view(begin, readBuffer.size()) << endl;
+    }
+
+    json message;
+    try
+    {
+        message = json::parse(begin, end);
+    }
+    catch (...)
+    {
+        readBuffer.clear();
+        throw;
+    }
+    readBuffer.clear();
+    TradeTracer::stamp(TraceStage::Parse);
+    return message;
+}
+
+int64_t NetworkClient::lastKernelReceiveNanoseconds() const
+{
+    return ws.next_layer().next_layer().lastKernelReceiveNanoseconds();
+}
+
 void NetworkClient::disconnect()
 {
     if (connected)
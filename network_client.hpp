@@ -6,7 +6,10 @@
 #include <boost/beast/websocket.hpp>
 #include <boost/beast/websocket/ssl.hpp>
 #include <nlohmann/json.hpp>
+#include <chrono>
 #include <string>
+#include "timestamping_socket.hpp"
+#include "tsc_clock.hpp"
 
 using namespace std;
 using json = nlohmann::json;
@@ -22,19 +25,31 @@ public:
     void establishConnection();
     void transmitData(const json &data);
     json receiveData();
+    // False if no complete message arrived within timeout; a partly read
+    // message is kept and finished by the next receive
+    bool receiveData(json &message, chrono::milliseconds timeout);
     void disconnect();
     bool isConnected() const { return connected; }
+    void enableMessageLogging(bool enable) { logMessages = enable; }
+
+    // 0 when instrumentation is compiled out
+    TscClock::ticks lastReceiveTicks() const { return receiveTicks; }
+    int64_t lastKernelReceiveNanoseconds() const;
 
 private:
     boost::asio::io_context io_context;
     ssl::context ssl_context;
     tcp::resolver resolver;
-    websocket::stream<beast::ssl_stream<tcp::socket>> ws;
+    websocket::stream<beast::ssl_stream<TimestampingSocket>> ws;
+    beast::flat_buffer readBuffer;
     string host;
     string endpoint;
     bool connected;
+    bool logMessages = true;
+    TscClock::ticks receiveTicks = 0;
 
     void setupSSL();
+    json decodeMessage();
     void logError(const string &operation, const string &message);
 };
 
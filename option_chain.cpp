@@ -0,0 +1,148 @@
+#include "option_chain.hpp"
+#include <algorithm>
+#include <cstdlib>
+using namespace std;
+
+namespace
+{
+    const double kMillisecondsPerYear = 365.0 * 24 * 3600 * 1000;
+
+    // Days since 1970-01-01 for a proleptic Gregorian date
+    int64_t daysFromCivil(int64_t year, unsigned month, unsigned day)
+    {
+        year -= month <= 2;
+        int64_t era = (year >= 0 ? year : year - 399) / 400;
+        unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+        unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + static_cast<int64_t>(dayOfEra) - 719468;
+    }
+
+    double numberOr(const json &object, const char *key, double fallback)
+    {
+        auto it = object.find(key);
+        return it != object.end() && it->is_number() ? it->get<double>() : fallback;
+    }
+}
+
+void OptionChain::reserve(size_t count)
+{
+    instruments.reserve(count);
+    expiryTimestampsMs.reserve(count);
+    strikes.reserve(count);
+    yearsToExpiry.reserve(count);
+    optionSigns.reserve(count);
+    underlyingPrices.reserve(count);
+    markPrices.reserve(count);
+    markVols.reserve(count);
+}
+
+void OptionChain::add(const string &instrument, int64_t expiryMs, double strike, bool isCall,
+                      double underlying, double markPrice, double markVol, int64_t asOfMs)
+{
+    instruments.push_back(instrument);
+    expiryTimestampsMs.push_back(expiryMs);
+    strikes.push_back(strike);
+    yearsToExpiry.push_back(double(expiryMs - asOfMs) / kMillisecondsPerYear);
+    optionSigns.push_back(isCall ? 1.0 : -1.0);
+    underlyingPrices.push_back(underlying);
+    markPrices.push_back(markPrice);
+    markVols.push_back(markVol);
+}
+
+void OptionChain::setValuationTime(int64_t asOfMs)
+{
+    for (size_t i = 0; i < size(); ++i)
+    {
+        yearsToExpiry[i] = double(expiryTimestampsMs[i] - asOfMs) / kMillisecondsPerYear;
+    }
+}
+
+void OptionChain::rescaleUnderlying(double ratio)
+{
+    for (auto &price : underlyingPrices)
+    {
+        price *= ratio;
+    }
+}
+
+bool OptionChain::parseInstrument(const string &name, int64_t &expiryMs, double &strike, bool &isCall)
+{
+    static const char *months[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN",
+                                   "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+
+    size_t first = name.find('-');
+    size_t second = name.find('-', first + 1);
+    size_t third = name.find('-', second + 1);
+    if (first == string::npos || second == string::npos || third == string::npos ||
+        third + 2 != name.size())
+    {
+        return false;
+    }
+
+    string date = name.substr(first + 1, second - first - 1);
+    if (date.size() < 6)
+    {
+        return false;
+    }
+    size_t dayDigits = date.size() - 5;
+    unsigned day = static_cast<unsigned>(atoi(date.substr(0, dayDigits).c_str()));
+    string monthText = date.substr(dayDigits, 3);
+    int year = 2000 + atoi(date.substr(dayDigits + 3).c_str());
+
+    auto month = find(begin(months), end(months), monthText);
+    if (month == end(months) || day == 0 || day > 31)
+    {
+        return false;
+    }
+
+    // Fractional strikes are written with 'd' for the decimal point (0d625)
+    string strikeText = name.substr(second + 1, third - second - 1);
+    replace(strikeText.begin(), strikeText.end(), 'd', '.');
+    strike = atof(strikeText.c_str());
+
+    char type = name.back();
+    if (strike <= 0.0 || (type != 'C' && type != 'P'))
+    {
+        return false;
+    }
+    isCall = type == 'C';
+
+    unsigned monthIndex = static_cast<unsigned>(month - begin(months)) + 1;
+    expiryMs = (daysFromCivil(year, monthIndex, day) * 86400 + 8 * 3600) * 1000;
+    return true;
+}
+
+OptionChain OptionChain::fromBookSummary(const json &response, int64_t asOfMs)
+{
+    const json &rows = response.contains("result") ? response["result"] : response;
+
+    OptionChain chain;
+    chain.reserve(rows.size());
+    for (const auto &row : rows)
+    {
+        if (!row.contains("instrument_name"))
+        {
+            continue;
+        }
+
+        const string &name = row["instrument_name"].get_ref<const string &>();
+        int64_t expiryMs;
+        double strike;
+        bool isCall;
+        if (!parseInstrument(name, expiryMs, strike, isCall) || expiryMs <= asOfMs)
+        {
+            continue;
+        }
+
+        double underlying = numberOr(row, "underlying_price", 0.0);
+        if (underlying <= 0.0)
+        {
+            continue;
+        }
+        double mark = numberOr(row, "mark_price", 0.0) * underlying;
+        double vol = numberOr(row, "mark_iv", 0.0) / 100.0;
+        chain.add(name, expiryMs, strike, isCall, underlying, mark, vol, asOfMs);
+    }
+    return chain;
+}
@@ -0,0 +1,40 @@
+#ifndef OPTION_CHAIN_HPP
+#define OPTION_CHAIN_HPP
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+// One currency's options as parallel columns. Prices are in the quote
+// currency (USD): Deribit quotes option marks in the underlying coin, so
+// loading multiplies them by the underlying price.
+struct OptionChain
+{
+    vector<string> instruments;
+    vector<int64_t> expiryTimestampsMs;
+    vector<double> strikes;
+    vector<double> yearsToExpiry;
+    vector<double> optionSigns; // +1 call, -1 put
+    vector<double> underlyingPrices;
+    vector<double> markPrices;
+    vector<double> markVols; // decimal, e.g. 0.55
+
+    size_t size() const { return instruments.size(); }
+    void reserve(size_t count);
+    void add(const string &instrument, int64_t expiryMs, double strike, bool isCall,
+             double underlying, double markPrice, double markVol, int64_t asOfMs);
+
+    void setValuationTime(int64_t asOfMs);
+    void rescaleUnderlying(double ratio);
+
+    // Builds a chain from a public/get_book_summary_by_currency response (kind=option)
+    static OptionChain fromBookSummary(const json &response, int64_t asOfMs);
+    // Parses names such as BTC-27DEC24-50000-C; expiries settle at 08:00 UTC
+    static bool parseInstrument(const string &name, int64_t &expiryMs, double &strike, bool &isCall);
+};
+
+#endif
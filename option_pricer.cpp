@@ -0,0 +1,535 @@
+#include "option_pricer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define OPTION_PRICER_AVX2 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+using namespace std;
+
+void ChainGreeks::resize(size_t count)
+{
+    prices.resize(count);
+    deltas.resize(count);
+    gammas.resize(count);
+    vegas.resize(count);
+    thetas.resize(count);
+}
+
+namespace
+{
+    constexpr size_t kChunkSize = 256;
+    constexpr double kMinYears = 1e-7;
+    constexpr double kMinVol = 1e-4;
+    constexpr double kMaxVol = 10.0;
+    constexpr int kMaxIterations = 64;
+    constexpr double kInvSqrt2Pi = 0.398942280401432677940;
+    constexpr double kDaysPerYear = 365.0;
+
+    struct PricingColumns
+    {
+        const double *spot;
+        const double *strike;
+        const double *years;
+        const double *sign;
+        const double *vol;
+        double rate;
+        double *price;
+        double *delta;
+        double *gamma;
+        double *vega;
+        double *theta;
+    };
+
+    // Hart's double-precision rational approximation (as given by West, 2005).
+    // Also returns exp(-x^2/2) so callers get the density for free.
+    double normalCdf(double x, double &gaussian)
+    {
+        double absX = fabs(x);
+        gaussian = exp(-0.5 * absX * absX);
+        double tail;
+        if (absX > 37.0)
+        {
+            tail = 0.0;
+        }
+        else if (absX < 7.07106781186547)
+        {
+            double numerator = 3.52624965998911e-02 * absX + 0.700383064443688;
+            numerator = numerator * absX + 6.37396220353165;
+            numerator = numerator * absX + 33.912866078383;
+            numerator = numerator * absX + 112.079291497871;
+            numerator = numerator * absX + 221.213596169931;
+            numerator = numerator * absX + 220.206867912376;
+            double denominator = 8.83883476483184e-02 * absX + 1.75566716318264;
+            denominator = denominator * absX + 16.064177579207;
+            denominator = denominator * absX + 86.7807322029461;
+            denominator = denominator * absX + 296.564248779674;
+            denominator = denominator * absX + 637.333633378831;
+            denominator = denominator * absX + 793.826512519948;
+            denominator = denominator * absX + 440.413735824752;
+            tail = gaussian * numerator / denominator;
+        }
+        else
+        {
+            double fraction = absX + 0.65;
+            fraction = absX + 4.0 / fraction;
+            fraction = absX + 3.0 / fraction;
+            fraction = absX + 2.0 / fraction;
+            fraction = absX + 1.0 / fraction;
+            tail = gaussian / fraction / 2.506628274631;
+        }
+        return x > 0.0 ? 1.0 - tail : tail;
+    }
+
+    void blackScholes(double spot, double strike, double years, double sign, double vol, double rate,
+                      double &price, double &delta, double &gamma, double &vega, double &theta)
+    {
+        years = max(years, kMinYears);
+        double sqrtYears = sqrt(years);
+        double volSqrtYears = vol * sqrtYears;
+        double d1 = (log(spot / strike) + (rate + 0.5 * vol * vol) * years) / volSqrtYears;
+        double d2 = d1 - volSqrtYears;
+        double discountedStrike = strike * exp(-rate * years);
+
+        double gaussian, unused;
+        double nd1 = normalCdf(sign * d1, gaussian);
+        double nd2 = normalCdf(sign * d2, unused);
+        double density = gaussian * kInvSqrt2Pi;
+
+        price = sign * (spot * nd1 - discountedStrike * nd2);
+        delta = sign * nd1;
+        gamma = density / (spot * volSqrtYears);
+        vega = spot * density * sqrtYears;
+        theta = -spot * density * vol / (2.0 * sqrtYears) - sign * rate * discountedStrike * nd2;
+    }
+
+    void valueRangeScalar(const PricingColumns &c, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            double vega, theta;
+            blackScholes(c.spot[i], c.strike[i], c.years[i], c.sign[i], c.vol[i], c.rate,
+                         c.price[i], c.delta[i], c.gamma[i], vega, theta);
+            c.vega[i] = vega / 100.0;
+            c.theta[i] = theta / kDaysPerYear;
+        }
+    }
+
+    bool priceInBounds(double target, double spot, double strike, double years, double sign, double rate)
+    {
+        double discountedStrike = strike * exp(-rate * max(years, kMinYears));
+        double lower = max(sign * (spot - discountedStrike), 0.0);
+        double upper = sign > 0.0 ? spot : discountedStrike;
+        return target > lower && target < upper;
+    }
+
+    // Newton steps kept inside a shrinking [low, high] bracket; a step that
+    // would leave the bracket becomes a bisection instead.
+    void impliedVolRangeScalar(const OptionChain &chain, const double *targets, double rate,
+                               const double *seeds, double *out, size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            double spot = chain.underlyingPrices[i];
+            double strike = chain.strikes[i];
+            double years = chain.yearsToExpiry[i];
+            double sign = chain.optionSigns[i];
+            if (!priceInBounds(targets[i], spot, strike, years, sign, rate))
+            {
+                out[i] = numeric_limits<double>::quiet_NaN();
+                continue;
+            }
+
+            double tolerance = 1e-10 * spot;
+            double low = kMinVol, high = kMaxVol;
+            double vol = seeds && seeds[i] > kMinVol ? min(seeds[i], kMaxVol) : 0.5;
+            for (int iteration = 0; iteration < kMaxIterations; ++iteration)
+            {
+                double price, delta, gamma, vega, theta;
+                blackScholes(spot, strike, years, sign, vol, rate, price, delta, gamma, vega, theta);
+                double error = price - targets[i];
+                if (fabs(error) < tolerance)
+                {
+                    break;
+                }
+                (error > 0.0 ? high : low) = vol;
+                double next = vol - error / vega;
+                vol = (vega > 0.0 && next > low && next < high) ? next : 0.5 * (low + high);
+            }
+            out[i] = vol;
+        }
+    }
+
+#ifdef OPTION_PRICER_AVX2
+    AVX2_TARGET inline __m256d exp4(__m256d x)
+    {
+        x = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(708.0)), _mm256_set1_pd(-708.0));
+        __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.44269504088896340736)),
+                                    _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93147180369123816490e-01), x);
+        r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.90821492927058770002e-10), r);
+
+        // Taylor series to r^11; |r| <= ln2/2 keeps the error below 1e-14
+        __m256d p = _mm256_set1_pd(1.0 / 39916800.0);
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 3628800.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 362880.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 40320.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 5040.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 720.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 120.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 24.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0 / 6.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(0.5));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.0));
+
+        __m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+        exponent = _mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52);
+        return _mm256_mul_pd(p, _mm256_castsi256_pd(exponent));
+    }
+
+    // Positive, normal inputs only (moneyness ratios)
+    AVX2_TARGET inline __m256d log4(__m256d x)
+    {
+        __m256i bits = _mm256_castpd_si256(x);
+        __m256i exponentField = _mm256_srli_epi64(bits, 52);
+        __m256d exponent = _mm256_sub_pd(
+            _mm256_castsi256_pd(_mm256_or_si256(exponentField, _mm256_set1_epi64x(0x4330000000000000LL))),
+            _mm256_set1_pd(4503599627370496.0 + 1023.0));
+        __m256d mantissa = _mm256_castsi256_pd(_mm256_or_si256(
+            _mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+            _mm256_set1_epi64x(0x3FF0000000000000LL)));
+
+        __m256d large = _mm256_cmp_pd(mantissa, _mm256_set1_pd(1.41421356237309504880), _CMP_GT_OQ);
+        mantissa = _mm256_blendv_pd(mantissa, _mm256_mul_pd(mantissa, _mm256_set1_pd(0.5)), large);
+        exponent = _mm256_add_pd(exponent, _mm256_and_pd(large, _mm256_set1_pd(1.0)));
+
+        // log(m) = 2 atanh(s), s = (m - 1) / (m + 1), |s| <= 0.172
+        __m256d f = _mm256_sub_pd(mantissa, _mm256_set1_pd(1.0));
+        __m256d s = _mm256_div_pd(f, _mm256_add_pd(f, _mm256_set1_pd(2.0)));
+        __m256d s2 = _mm256_mul_pd(s, s);
+        __m256d p = _mm256_set1_pd(1.0 / 17.0);
+        p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(1.0 / 15.0));
+        p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(1.0 / 13.0));
+        p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(1.0 / 11.0));
+        p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(1.0 / 9.0));
+        p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(1.0 / 7.0));
+        p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(1.0 / 5.0));
+        p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(1.0 / 3.0));
+        p = _mm256_fmadd_pd(p, s2, _mm256_set1_pd(1.0));
+        __m256d logMantissa = _mm256_mul_pd(_mm256_add_pd(s, s), p);
+
+        __m256d result = _mm256_fmadd_pd(exponent, _mm256_set1_pd(1.90821492927058770002e-10), logMantissa);
+        return _mm256_fmadd_pd(exponent, _mm256_set1_pd(6.93147180369123816490e-01), result);
+    }
+
+    AVX2_TARGET inline __m256d normalCdf4(__m256d x, __m256d &gaussian)
+    {
+        const __m256d signMask = _mm256_set1_pd(-0.0);
+        __m256d absX = _mm256_andnot_pd(signMask, x);
+        gaussian = exp4(_mm256_mul_pd(_mm256_set1_pd(-0.5), _mm256_mul_pd(absX, absX)));
+
+        __m256d numerator = _mm256_fmadd_pd(_mm256_set1_pd(3.52624965998911e-02), absX, _mm256_set1_pd(0.700383064443688));
+        numerator = _mm256_fmadd_pd(numerator, absX, _mm256_set1_pd(6.37396220353165));
+        numerator = _mm256_fmadd_pd(numerator, absX, _mm256_set1_pd(33.912866078383));
+        numerator = _mm256_fmadd_pd(numerator, absX, _mm256_set1_pd(112.079291497871));
+        numerator = _mm256_fmadd_pd(numerator, absX, _mm256_set1_pd(221.213596169931));
+        numerator = _mm256_fmadd_pd(numerator, absX, _mm256_set1_pd(220.206867912376));
+        __m256d denominator = _mm256_fmadd_pd(_mm256_set1_pd(8.83883476483184e-02), absX, _mm256_set1_pd(1.75566716318264));
+        denominator = _mm256_fmadd_pd(denominator, absX, _mm256_set1_pd(16.064177579207));
+        denominator = _mm256_fmadd_pd(denominator, absX, _mm256_set1_pd(86.7807322029461));
+        denominator = _mm256_fmadd_pd(denominator, absX, _mm256_set1_pd(296.564248779674));
+        denominator = _mm256_fmadd_pd(denominator, absX, _mm256_set1_pd(637.333633378831));
+        denominator = _mm256_fmadd_pd(denominator, absX, _mm256_set1_pd(793.826512519948));
+        denominator = _mm256_fmadd_pd(denominator, absX, _mm256_set1_pd(440.413735824752));
+        __m256d nearTail = _mm256_div_pd(_mm256_mul_pd(gaussian, numerator), denominator);
+
+        __m256d fraction = _mm256_add_pd(absX, _mm256_set1_pd(0.65));
+        fraction = _mm256_add_pd(absX, _mm256_div_pd(_mm256_set1_pd(4.0), fraction));
+        fraction = _mm256_add_pd(absX, _mm256_div_pd(_mm256_set1_pd(3.0), fraction));
+        fraction = _mm256_add_pd(absX, _mm256_div_pd(_mm256_set1_pd(2.0), fraction));
+        fraction = _mm256_add_pd(absX, _mm256_div_pd(_mm256_set1_pd(1.0), fraction));
+        __m256d farTail = _mm256_div_pd(gaussian, _mm256_mul_pd(fraction, _mm256_set1_pd(2.506628274631)));
+
+        __m256d useNear = _mm256_cmp_pd(absX, _mm256_set1_pd(7.07106781186547), _CMP_LT_OQ);
+        __m256d tail = _mm256_blendv_pd(farTail, nearTail, useNear);
+        tail = _mm256_andnot_pd(_mm256_cmp_pd(absX, _mm256_set1_pd(37.0), _CMP_GT_OQ), tail);
+
+        __m256d positive = _mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_GT_OQ);
+        return _mm256_blendv_pd(tail, _mm256_sub_pd(_mm256_set1_pd(1.0), tail), positive);
+    }
+
+    AVX2_TARGET inline void blackScholes4(__m256d spot, __m256d strike, __m256d years, __m256d sign,
+                                          __m256d vol, __m256d rate, __m256d &price, __m256d &delta,
+                                          __m256d &gamma, __m256d &vega, __m256d &theta)
+    {
+        years = _mm256_max_pd(years, _mm256_set1_pd(kMinYears));
+        __m256d sqrtYears = _mm256_sqrt_pd(years);
+        __m256d volSqrtYears = _mm256_mul_pd(vol, sqrtYears);
+        __m256d drift = _mm256_fmadd_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(vol, vol), rate);
+        __m256d d1 = _mm256_div_pd(_mm256_fmadd_pd(drift, years, log4(_mm256_div_pd(spot, strike))), volSqrtYears);
+        __m256d d2 = _mm256_sub_pd(d1, volSqrtYears);
+        __m256d discountedStrike = _mm256_mul_pd(strike, exp4(_mm256_mul_pd(_mm256_sub_pd(_mm256_setzero_pd(), rate), years)));
+
+        __m256d gaussian, unused;
+        __m256d nd1 = normalCdf4(_mm256_mul_pd(sign, d1), gaussian);
+        __m256d nd2 = normalCdf4(_mm256_mul_pd(sign, d2), unused);
+        __m256d density = _mm256_mul_pd(gaussian, _mm256_set1_pd(kInvSqrt2Pi));
+
+        price = _mm256_mul_pd(sign, _mm256_fmsub_pd(spot, nd1, _mm256_mul_pd(discountedStrike, nd2)));
+        delta = _mm256_mul_pd(sign, nd1);
+        gamma = _mm256_div_pd(density, _mm256_mul_pd(spot, volSqrtYears));
+        __m256d spotDensity = _mm256_mul_pd(spot, density);
+        vega = _mm256_mul_pd(spotDensity, sqrtYears);
+        __m256d decay = _mm256_div_pd(_mm256_mul_pd(spotDensity, vol), _mm256_add_pd(sqrtYears, sqrtYears));
+        __m256d carry = _mm256_mul_pd(_mm256_mul_pd(sign, rate), _mm256_mul_pd(discountedStrike, nd2));
+        theta = _mm256_sub_pd(_mm256_sub_pd(_mm256_setzero_pd(), decay), carry);
+    }
+
+    AVX2_TARGET void valueRangeAvx2(const PricingColumns &c, size_t begin, size_t end)
+    {
+        const __m256d rate = _mm256_set1_pd(c.rate);
+        const __m256d perVolPoint = _mm256_set1_pd(0.01);
+        const __m256d perDay = _mm256_set1_pd(1.0 / kDaysPerYear);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            __m256d price, delta, gamma, vega, theta;
+            blackScholes4(_mm256_loadu_pd(c.spot + i), _mm256_loadu_pd(c.strike + i),
+                          _mm256_loadu_pd(c.years + i), _mm256_loadu_pd(c.sign + i),
+                          _mm256_loadu_pd(c.vol + i), rate, price, delta, gamma, vega, theta);
+            _mm256_storeu_pd(c.price + i, price);
+            _mm256_storeu_pd(c.delta + i, delta);
+            _mm256_storeu_pd(c.gamma + i, gamma);
+            _mm256_storeu_pd(c.vega + i, _mm256_mul_pd(vega, perVolPoint));
+            _mm256_storeu_pd(c.theta + i, _mm256_mul_pd(theta, perDay));
+        }
+        valueRangeScalar(c, i, end);
+    }
+
+    // Four independent safeguarded Newton iterations in one register; lanes
+    // that converge are frozen while the others continue.
+    AVX2_TARGET void impliedVolRangeAvx2(const OptionChain &chain, const double *targets, double rate,
+                                         const double *seeds, double *out, size_t begin, size_t end)
+    {
+        const __m256d rateVec = _mm256_set1_pd(rate);
+        const __m256d half = _mm256_set1_pd(0.5);
+        const __m256d signMask = _mm256_set1_pd(-0.0);
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+        {
+            alignas(32) double seed[4];
+            alignas(32) double valid[4];
+            for (size_t lane = 0; lane < 4; ++lane)
+            {
+                size_t k = i + lane;
+                double s = seeds ? seeds[k] : 0.0;
+                seed[lane] = s > kMinVol ? min(s, kMaxVol) : 0.5;
+                valid[lane] = priceInBounds(targets[k], chain.underlyingPrices[k], chain.strikes[k],
+                                            chain.yearsToExpiry[k], chain.optionSigns[k], rate)
+                                  ? 1.0
+                                  : 0.0;
+            }
+
+            __m256d spot = _mm256_loadu_pd(chain.underlyingPrices.data() + i);
+            __m256d strike = _mm256_loadu_pd(chain.strikes.data() + i);
+            __m256d years = _mm256_loadu_pd(chain.yearsToExpiry.data() + i);
+            __m256d sign = _mm256_loadu_pd(chain.optionSigns.data() + i);
+            __m256d target = _mm256_loadu_pd(targets + i);
+            __m256d tolerance = _mm256_mul_pd(spot, _mm256_set1_pd(1e-10));
+            __m256d vol = _mm256_load_pd(seed);
+            __m256d low = _mm256_set1_pd(kMinVol);
+            __m256d high = _mm256_set1_pd(kMaxVol);
+            __m256d active = _mm256_cmp_pd(_mm256_load_pd(valid), _mm256_set1_pd(0.5), _CMP_GT_OQ);
+
+            for (int iteration = 0; iteration < kMaxIterations && _mm256_movemask_pd(active); ++iteration)
+            {
+                __m256d price, delta, gamma, vega, theta;
+                blackScholes4(spot, strike, years, sign, vol, rateVec, price, delta, gamma, vega, theta);
+                __m256d error = _mm256_sub_pd(price, target);
+
+                __m256d converged = _mm256_cmp_pd(_mm256_andnot_pd(signMask, error), tolerance, _CMP_LT_OQ);
+                active = _mm256_andnot_pd(converged, active);
+
+                __m256d tooHigh = _mm256_cmp_pd(error, _mm256_setzero_pd(), _CMP_GT_OQ);
+                high = _mm256_blendv_pd(high, _mm256_blendv_pd(high, vol, tooHigh), active);
+                low = _mm256_blendv_pd(low, _mm256_blendv_pd(vol, low, tooHigh), active);
+
+                __m256d next = _mm256_sub_pd(vol, _mm256_div_pd(error, vega));
+                __m256d inside = _mm256_and_pd(_mm256_cmp_pd(next, low, _CMP_GT_OQ),
+                                               _mm256_cmp_pd(next, high, _CMP_LT_OQ));
+                inside = _mm256_and_pd(inside, _mm256_cmp_pd(vega, _mm256_setzero_pd(), _CMP_GT_OQ));
+                __m256d bisect = _mm256_mul_pd(half, _mm256_add_pd(low, high));
+                vol = _mm256_blendv_pd(vol, _mm256_blendv_pd(bisect, next, inside), active);
+            }
+
+            __m256d isValid = _mm256_cmp_pd(_mm256_load_pd(valid), _mm256_set1_pd(0.5), _CMP_GT_OQ);
+            vol = _mm256_blendv_pd(_mm256_set1_pd(numeric_limits<double>::quiet_NaN()), vol, isValid);
+            _mm256_storeu_pd(out + i, vol);
+        }
+        impliedVolRangeScalar(chain, targets, rate, seeds, out, i, end);
+    }
+
+    bool cpuHasAvx2()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    }
+#else
+    bool cpuHasAvx2()
+    {
+        return false;
+    }
+#endif
+
+    const bool avx2Supported = cpuHasAvx2();
+}
+
+bool OptionPricingEngine::scalarOnly = false;
+
+bool OptionPricingEngine::usingAvx2()
+{
+    return avx2Supported && !scalarOnly;
+}
+
+void OptionPricingEngine::forceScalar(bool enable)
+{
+    scalarOnly = enable;
+}
+
+OptionPricingEngine::OptionPricingEngine(size_t threadCount)
+{
+    size_t extraThreads = threadCount > 1 ? threadCount - 1 : 0;
+    for (size_t i = 0; i < extraThreads; ++i)
+    {
+        workers.emplace_back([this]
+                             { workerLoop(); });
+    }
+}
+
+OptionPricingEngine::~OptionPricingEngine()
+{
+    {
+        lock_guard<mutex> lock(poolMutex);
+        shuttingDown = true;
+    }
+    workReady.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void OptionPricingEngine::revalue(const OptionChain &chain, double rate, ChainGreeks &out, const double *vols)
+{
+    out.resize(chain.size());
+    PricingColumns columns{
+        chain.underlyingPrices.data(),
+        chain.strikes.data(),
+        chain.yearsToExpiry.data(),
+        chain.optionSigns.data(),
+        vols ? vols : chain.markVols.data(),
+        rate,
+        out.prices.data(),
+        out.deltas.data(),
+        out.gammas.data(),
+        out.vegas.data(),
+        out.thetas.data()};
+
+    parallelFor(chain.size(), [&](size_t begin, size_t end)
+                {
+#ifdef OPTION_PRICER_AVX2
+                    if (usingAvx2())
+                    {
+                        valueRangeAvx2(columns, begin, end);
+                        return;
+                    }
+#endif
+                    valueRangeScalar(columns, begin, end); });
+}
+
+void OptionPricingEngine::impliedVols(const OptionChain &chain, const double *targetPrices, double rate,
+                                      vector<double> &volsOut, const double *seedVols)
+{
+    volsOut.resize(chain.size());
+    double *out = volsOut.data();
+
+    parallelFor(chain.size(), [&](size_t begin, size_t end)
+                {
+#ifdef OPTION_PRICER_AVX2
+                    if (usingAvx2())
+                    {
+                        impliedVolRangeAvx2(chain, targetPrices, rate, seedVols, out, begin, end);
+                        return;
+                    }
+#endif
+                    impliedVolRangeScalar(chain, targetPrices, rate, seedVols, out, begin, end); });
+}
+
+void OptionPricingEngine::parallelFor(size_t count, const function<void(size_t, size_t)> &task)
+{
+    if (workers.empty() || count <= kChunkSize)
+    {
+        task(0, count);
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(poolMutex);
+        currentTask = task;
+        taskCount = count;
+        nextChunk.store(0, memory_order_relaxed);
+        activeWorkers = workers.size();
+        generation++;
+    }
+    workReady.notify_all();
+
+    runChunks();
+
+    unique_lock<mutex> lock(poolMutex);
+    workDone.wait(lock, [this]
+                  { return activeWorkers == 0; });
+    currentTask = nullptr;
+}
+
+void OptionPricingEngine::workerLoop()
+{
+    uint64_t seenGeneration = 0;
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(poolMutex);
+            workReady.wait(lock, [&]
+                           { return shuttingDown || generation != seenGeneration; });
+            if (shuttingDown)
+            {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        runChunks();
+
+        lock_guard<mutex> lock(poolMutex);
+        if (--activeWorkers == 0)
+        {
+            workDone.notify_one();
+        }
+    }
+}
+
+void OptionPricingEngine::runChunks()
+{
+    size_t chunk;
+    while ((chunk = nextChunk.fetch_add(1, memory_order_relaxed)) * kChunkSize < taskCount)
+    {
+        size_t begin = chunk * kChunkSize;
+        currentTask(begin, min(begin + kChunkSize, taskCount));
+    }
+}
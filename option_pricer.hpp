@@ -0,0 +1,71 @@
+#ifndef OPTION_PRICER_HPP
+#define OPTION_PRICER_HPP
+
+#include "option_chain.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Output columns, same order as the chain. Vega is per vol point (1%) and
+// theta per calendar day, matching how Deribit reports greeks.
+struct ChainGreeks
+{
+    vector<double> prices;
+    vector<double> deltas;
+    vector<double> gammas;
+    vector<double> vegas;
+    vector<double> thetas;
+
+    void resize(size_t count);
+};
+
+// Black-Scholes valuation of whole chains. The kernels work on four options
+// per AVX2 register (scalar fallback otherwise) and the chain is split into
+// chunks handed to a persistent worker pool, so revaluing on every
+// underlying tick does not pay thread start-up.
+class OptionPricingEngine
+{
+public:
+    explicit OptionPricingEngine(size_t threadCount = thread::hardware_concurrency());
+    ~OptionPricingEngine();
+
+    OptionPricingEngine(const OptionPricingEngine &) = delete;
+    OptionPricingEngine &operator=(const OptionPricingEngine &) = delete;
+
+    // Uses chain.markVols when vols is null
+    void revalue(const OptionChain &chain, double rate, ChainGreeks &out, const double *vols = nullptr);
+
+    // Newton iteration seeded from seedVols (or 0.5); NaN where no vol reproduces the price
+    void impliedVols(const OptionChain &chain, const double *targetPrices, double rate,
+                     vector<double> &volsOut, const double *seedVols = nullptr);
+
+    size_t threadCount() const { return workers.size() + 1; }
+
+    static bool usingAvx2();
+    static void forceScalar(bool scalarOnly);
+
+private:
+    vector<thread> workers;
+    mutex poolMutex;
+    condition_variable workReady;
+    condition_variable workDone;
+    function<void(size_t, size_t)> currentTask;
+    size_t taskCount = 0;
+    atomic<size_t> nextChunk{0};
+    size_t activeWorkers = 0;
+    uint64_t generation = 0;
+    bool shuttingDown = false;
+
+    static bool scalarOnly;
+
+    void parallelFor(size_t count, const function<void(size_t, size_t)> &task);
+    void workerLoop();
+    void runChunks();
+};
+
+#endif
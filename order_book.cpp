@@ -0,0 +1,90 @@
+#include "order_book.hpp"
+using namespace std;
+
+namespace
+{
+    template <typename Side>
+    void applyLevels(Side &side, const json &levels)
+    {
+        for (const auto &level : levels)
+        {
+            // [action, price, amount] for incremental books, [price, amount] for grouped ones
+            if (level.size() >= 3 && level[0].is_string())
+            {
+                double price = level[1].get<double>();
+                if (level[0] == "delete")
+                {
+                    side.erase(price);
+                }
+                else
+                {
+                    side[price] = level[2].get<double>();
+                }
+            }
+            else if (level.size() >= 2)
+            {
+                side[level[0].get<double>()] = level[1].get<double>();
+            }
+        }
+    }
+
+    template <typename Side>
+    json levelsJson(const Side &side, size_t depth)
+    {
+        json levels = json::array();
+        for (auto it = side.begin(); it != side.end() && levels.size() < depth; ++it)
+        {
+            levels.push_back({it->first, it->second});
+        }
+        return levels;
+    }
+}
+
+LocalOrderBook::LocalOrderBook(size_t depthLimit) : maxDepth(depthLimit) {}
+
+void LocalOrderBook::apply(const json &data)
+{
+    // Grouped channels carry no type and are always full snapshots
+    bool snapshot = data.value("type", "snapshot") == "snapshot";
+    int64_t nextChangeId = data.value("change_id", int64_t(0));
+
+    if (snapshot)
+    {
+        bids.clear();
+        asks.clear();
+        consistent = true;
+    }
+    else if (!consistent || data.value("prev_change_id", int64_t(-1)) != changeId)
+    {
+        consistent = false;
+        return;
+    }
+
+    if (data.contains("bids"))
+    {
+        applyLevels(bids, data["bids"]);
+    }
+    if (data.contains("asks"))
+    {
+        applyLevels(asks, data["asks"]);
+    }
+
+    instrument = data.value("instrument_name", instrument);
+    changeId = nextChangeId;
+    timestampMs = data.value("timestamp", timestampMs);
+}
+
+json LocalOrderBook::depthResult(size_t depth) const
+{
+    json result = {
+        {"instrument_name", instrument},
+        {"timestamp", timestampMs},
+        {"change_id", changeId},
+        {"bids", levelsJson(bids, depth)},
+        {"asks", levelsJson(asks, depth)},
+        {"best_bid_price", bids.empty() ? json(nullptr) : json(bids.begin()->first)},
+        {"best_bid_amount", bids.empty() ? 0.0 : bids.begin()->second},
+        {"best_ask_price", asks.empty() ? json(nullptr) : json(asks.begin()->first)},
+        {"best_ask_amount", asks.empty() ? 0.0 : asks.begin()->second}};
+    return result;
+}
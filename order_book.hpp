@@ -0,0 +1,48 @@
+#ifndef ORDER_BOOK_HPP
+#define ORDER_BOOK_HPP
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <string>
+
+using namespace std;
+using json = nlohmann::json;
+
+// Book rebuilt from book.* subscription notifications so depth queries can
+// be answered without a request. Incremental channels are checked with
+// change_id / prev_change_id; a gap marks the book invalid until the next
+// snapshot.
+class LocalOrderBook
+{
+public:
+    // depthLimit is the level count a grouped snapshot channel carries
+    explicit LocalOrderBook(size_t depthLimit = numeric_limits<size_t>::max());
+
+    void apply(const json &data);
+
+    bool valid() const { return consistent; }
+    size_t depthLimit() const { return maxDepth; }
+    int64_t lastChangeId() const { return changeId; }
+    int64_t lastTimestampMs() const { return timestampMs; }
+
+    // Best price first
+    const map<double, double, greater<double>> &bidLevels() const { return bids; }
+    const map<double, double> &askLevels() const { return asks; }
+
+    // Same shape as the result of public/get_order_book
+    json depthResult(size_t depth) const;
+
+private:
+    map<double, double, greater<double>> bids;
+    map<double, double> asks;
+    size_t maxDepth;
+    string instrument;
+    int64_t changeId = 0;
+    int64_t timestampMs = 0;
+    bool consistent = false;
+};
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef ORDER_TYPES_HPP
+#define ORDER_TYPES_HPP
+
+enum class OrderSide
+{
+    Buy,
+    Sell
+};
+
+#endif
@@ -1,31 +1,52 @@
 // performance_monitor.cpp
 #include "performance_monitor.hpp"
 #include <iostream>
-#include <numeric>
+#include <unordered_map>
 using namespace std;
 
-mutex PerformanceMonitor::metricsMutex;
-map<string, vector<double>> PerformanceMonitor::operationMetrics;
 bool PerformanceMonitor::profilingEnabled = false;
+array<atomic<bool>, Instrumentation::kMaxMetrics> PerformanceMonitor::ownedMetrics{};
 
-chrono::high_resolution_clock::time_point PerformanceMonitor::startTimer()
+TscClock::ticks PerformanceMonitor::startTimer()
 {
-    return chrono::high_resolution_clock::now();
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
+    return TscClock::now();
+#else
+    return 0;
+#endif
 }
 
-void PerformanceMonitor::stopTimer(const chrono::high_resolution_clock::time_point &startTime,
+MetricId PerformanceMonitor::metricFor(const string &operationType)
+{
+    thread_local unordered_map<string, MetricId> interned;
+    auto it = interned.find(operationType);
+    if (it != interned.end())
+    {
+        return it->second;
+    }
+
+    MetricId metric = Instrumentation::intern(operationType);
+    ownedMetrics[metric].store(true, memory_order_relaxed);
+    interned.emplace(operationType, metric);
+    return metric;
+}
+
+void PerformanceMonitor::stopTimer(const TscClock::ticks &startTime,
                                    const string &operationType)
 {
-    auto endTime = chrono::high_resolution_clock::now();
-    chrono::duration<double> duration = endTime - startTime;
-    double milliseconds = duration.count() * 1000.0;
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
+    TscClock::ticks elapsed = TscClock::nowOrdered() - startTime;
 
-    updateMetrics(operationType, milliseconds);
+    Instrumentation::record(metricFor(operationType), elapsed);
 
     if (profilingEnabled)
     {
-        cout << operationType << " took " << milliseconds << " ms" << endl;
+        cout << operationType << " took " << TscClock::toMilliseconds(elapsed) << " ms" << endl;
     }
+#else
+    (void)startTime;
+    (void)operationType;
+#endif
 }
 
 void PerformanceMonitor::enableProfiling(bool enable)
@@ -35,34 +56,31 @@ void PerformanceMonitor::enableProfiling(bool enable)
 
 map<string, double> PerformanceMonitor::getAverageTimings()
 {
-    lock_guard<mutex> lock(metricsMutex);
-    map<string, double> averages;
+    TscClock::recalibrateIfDue();
 
-    for (const auto &[operation, timings] : operationMetrics)
+    map<string, double> averages;
+    for (MetricId metric = 0; metric < Instrumentation::kMaxMetrics; ++metric)
     {
-        if (!timings.empty())
+        if (!ownedMetrics[metric].load(memory_order_relaxed))
         {
-            double sum = accumulate(timings.begin(), timings.end(), 0.0);
-            averages[operation] = sum / timings.size();
+            continue;
+        }
+        MetricStats stats = Instrumentation::stats(metric);
+        if (stats.count > 0)
+        {
+            averages[stats.name] = stats.averageMilliseconds();
         }
     }
-
     return averages;
 }
 
 void PerformanceMonitor::clearMetrics()
 {
-    lock_guard<mutex> lock(metricsMutex);
-    operationMetrics.clear();
-}
-
-void PerformanceMonitor::updateMetrics(const string &operation, double duration)
-{
-    lock_guard<mutex> lock(metricsMutex);
-    operationMetrics[operation].push_back(duration);
-
-    if (operationMetrics[operation].size() > 1000)
+    for (MetricId metric = 0; metric < Instrumentation::kMaxMetrics; ++metric)
     {
-        operationMetrics[operation].erase(operationMetrics[operation].begin());
+        if (ownedMetrics[metric].load(memory_order_relaxed))
+        {
+            Instrumentation::reset(metric);
+        }
     }
 }
@@ -1,19 +1,22 @@
 #ifndef PERFORMANCE_MONITOR_HPP
 #define PERFORMANCE_MONITOR_HPP
 
-#include <chrono>
+#include "instrumentation.hpp"
+#include <array>
+#include <atomic>
 #include <string>
 #include <map>
-#include <vector>
-#include <mutex>
 
 using namespace std;
 
+// Coarse timers (connection setup and the like) recorded into Instrumentation.
+// getAverageTimings and clearMetrics only touch metrics recorded through
+// stopTimer.
 class PerformanceMonitor
 {
 public:
-    static chrono::high_resolution_clock::time_point startTimer();
-    static void stopTimer(const chrono::high_resolution_clock::time_point &startTime,
+    static TscClock::ticks startTimer();
+    static void stopTimer(const TscClock::ticks &startTime,
                           const string &operationType);
 
     static void enableProfiling(bool enable);
@@ -21,11 +24,11 @@ public:
     static void clearMetrics();
 
 private:
-    static mutex metricsMutex;
-    static map<string, vector<double>> operationMetrics;
     static bool profilingEnabled;
+    // Set when a thread first interns a name through stopTimer
+    static array<atomic<bool>, Instrumentation::kMaxMetrics> ownedMetrics;
 
-    static void updateMetrics(const string &operation, double duration);
+    static MetricId metricFor(const string &operationType);
 };
 
 #endif
@@ -0,0 +1,106 @@
+#include "request_cache.hpp"
+using namespace std;
+
+json RequestCache::getOrFetch(const string &key, chrono::milliseconds ttl, const Fetcher &fetch, bool mayWait)
+{
+    unique_lock<mutex> lock(cacheMutex);
+    auto now = chrono::steady_clock::now();
+    auto it = entries.find(key);
+    if (it != entries.end() && !it->second.invalidated)
+    {
+        Entry &entry = it->second;
+        if (entry.ready && now - entry.fetchedAt <= ttl)
+        {
+            counters.hits++;
+            return entry.response.get();
+        }
+        // The fetching thread can get here again through a callback run while
+        // it waits for the reply; waiting on itself would never return.
+        if (!entry.ready && mayWait && entry.fetchingThread != this_thread::get_id())
+        {
+            counters.coalesced++;
+            shared_future<json> response = entry.response;
+            lock.unlock();
+            return response.get();
+        }
+        if (!entry.ready)
+        {
+            counters.misses++;
+            lock.unlock();
+            return fetch();
+        }
+    }
+
+    counters.misses++;
+    promise<json> pending;
+    uint64_t generation = ++nextGeneration;
+    entries[key] = Entry{pending.get_future().share(), now, this_thread::get_id(), generation, false, false};
+    lock.unlock();
+
+    // An invalidated or replaced entry is no longer ours to complete
+    auto finish = [&](bool keep)
+    {
+        lock.lock();
+        auto own = entries.find(key);
+        if (own == entries.end() || own->second.generation != generation)
+        {
+            return;
+        }
+        if (keep && !own->second.invalidated)
+        {
+            own->second.ready = true;
+            own->second.fetchedAt = chrono::steady_clock::now();
+        }
+        else
+        {
+            entries.erase(own);
+        }
+    };
+
+    try
+    {
+        json response = fetch();
+        pending.set_value(response);
+        finish(true);
+        return response;
+    }
+    catch (...)
+    {
+        pending.set_exception(current_exception());
+        finish(false);
+        throw;
+    }
+}
+
+void RequestCache::invalidate(const string &prefix)
+{
+    lock_guard<mutex> lock(cacheMutex);
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (it->first.compare(0, prefix.size(), prefix) != 0)
+        {
+            ++it;
+        }
+        else if (it->second.ready)
+        {
+            it = entries.erase(it);
+        }
+        else
+        {
+            it->second.invalidated = true;
+            ++it;
+        }
+    }
+}
+
+void RequestCache::countSubscriptionHit()
+{
+    lock_guard<mutex> lock(cacheMutex);
+    counters.subscriptionHits++;
+}
+
+RequestCacheStats RequestCache::stats() const
+{
+    lock_guard<mutex> lock(cacheMutex);
+    return counters;
+}
@@ -0,0 +1,60 @@
+#ifndef REQUEST_CACHE_HPP
+#define REQUEST_CACHE_HPP
+
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+using json = nlohmann::json;
+
+struct RequestCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t coalesced = 0;
+    uint64_t subscriptionHits = 0;
+};
+
+// Read-through cache for idempotent requests. A response younger than the
+// TTL is returned as is; callers asking for a key that is already being
+// fetched wait for that fetch instead of starting their own, unless they
+// pass mayWait = false because the fetch could need something they hold.
+// Failed fetches are not cached and the error reaches every waiting caller.
+class RequestCache
+{
+public:
+    using Fetcher = function<json()>;
+
+    json getOrFetch(const string &key, chrono::milliseconds ttl, const Fetcher &fetch, bool mayWait = true);
+
+    // Drops entries whose key starts with prefix. A fetch already in flight
+    // still answers its waiters but its response is not kept, and later
+    // callers start a new fetch.
+    void invalidate(const string &prefix = "");
+    void countSubscriptionHit();
+    RequestCacheStats stats() const;
+
+private:
+    struct Entry
+    {
+        shared_future<json> response;
+        chrono::steady_clock::time_point fetchedAt;
+        thread::id fetchingThread;
+        uint64_t generation = 0;
+        bool ready = false;
+        bool invalidated = false;
+    };
+
+    mutable mutex cacheMutex;
+    unordered_map<string, Entry> entries;
+    uint64_t nextGeneration = 0;
+    RequestCacheStats counters;
+};
+
+#endif
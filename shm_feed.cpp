@@ -0,0 +1,441 @@
+#include "shm_feed.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+namespace
+{
+    constexpr uint64_t kMagic = 0x3144454546524544ULL; // "DERFEED1"
+    constexpr uint32_t kVersion = 1;
+
+    struct alignas(64) SegmentHeader
+    {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t slotBytes;
+        uint64_t capacity;
+        alignas(64) atomic<uint64_t> published;
+        atomic<uint32_t> producerActive;
+    };
+
+    struct alignas(64) Slot
+    {
+        atomic<uint64_t> version;
+        FeedRecord record;
+    };
+
+    static_assert(atomic<uint64_t>::is_always_lock_free, "shared memory ring needs lock-free 64-bit atomics");
+
+    constexpr size_t kRecordHeaderBytes = offsetof(FeedRecord, levels);
+
+    size_t usedBytes(const FeedRecord &record)
+    {
+        return kRecordHeaderBytes + min(record.levelCount(), kFeedMaxLevels) * sizeof(FeedLevel);
+    }
+
+    string segmentPath(const string &name)
+    {
+        return name.empty() || name[0] != '/' ? "/" + name : name;
+    }
+
+    size_t segmentBytes(size_t capacity)
+    {
+        return sizeof(SegmentHeader) + capacity * sizeof(Slot);
+    }
+
+    SegmentHeader &headerOf(void *mapping)
+    {
+        return *static_cast<SegmentHeader *>(mapping);
+    }
+
+    const SegmentHeader &headerOf(const void *mapping)
+    {
+        return *static_cast<const SegmentHeader *>(mapping);
+    }
+
+    Slot *slotsOf(void *mapping)
+    {
+        return reinterpret_cast<Slot *>(static_cast<char *>(mapping) + sizeof(SegmentHeader));
+    }
+
+    const Slot *slotsOf(const void *mapping)
+    {
+        return reinterpret_cast<const Slot *>(static_cast<const char *>(mapping) + sizeof(SegmentHeader));
+    }
+
+    // Not TscClock: its calibration is per process, CLOCK_MONOTONIC is shared
+    int64_t monotonicNanoseconds()
+    {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return int64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+    }
+
+    void copyInstrument(FeedRecord &record, const string &instrument)
+    {
+        size_t length = min(instrument.size(), kFeedInstrumentLength - 1);
+        memcpy(record.instrument, instrument.data(), length);
+        record.instrument[length] = '\0';
+    }
+
+    double numberOr(const json &object, const char *key, double fallback)
+    {
+        auto it = object.find(key);
+        return it != object.end() && it->is_number() ? it->get<double>() : fallback;
+    }
+}
+
+ShmFeedPublisher::ShmFeedPublisher(const string &name, size_t capacity)
+    : segmentName(segmentPath(name)), slotCount(1)
+{
+#ifdef _WIN32
+    throw runtime_error("ShmFeedPublisher requires POSIX shared memory");
+#else
+    while (slotCount < max<size_t>(capacity, 2))
+    {
+        slotCount <<= 1;
+    }
+    mappedBytes = segmentBytes(slotCount);
+
+    shm_unlink(segmentName.c_str());
+    int fd = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        throw runtime_error("Cannot create feed segment " + segmentName + ": " + strerror(errno));
+    }
+    if (ftruncate(fd, static_cast<off_t>(mappedBytes)) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        shm_unlink(segmentName.c_str());
+        throw runtime_error("Cannot size feed segment " + segmentName + ": " + strerror(error));
+    }
+
+    mapping = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        shm_unlink(segmentName.c_str());
+        throw runtime_error("Cannot map feed segment " + segmentName + ": " + strerror(errno));
+    }
+
+    // ftruncate zero-fills, so every slot version starts at 0 (never written)
+    auto &header = headerOf(mapping);
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.slotBytes = sizeof(Slot);
+    header.capacity = slotCount;
+    header.producerActive.store(1, memory_order_release);
+#endif
+}
+
+ShmFeedPublisher::~ShmFeedPublisher()
+{
+#ifndef _WIN32
+    if (mapping)
+    {
+        headerOf(mapping).producerActive.store(0, memory_order_release);
+        munmap(mapping, mappedBytes);
+        shm_unlink(segmentName.c_str());
+    }
+#endif
+}
+
+uint64_t ShmFeedPublisher::publishedCount() const
+{
+    return headerOf(mapping).published.load(memory_order_acquire);
+}
+
+void ShmFeedPublisher::publish(FeedRecord &record)
+{
+    record.publishMonotonicNs = monotonicNanoseconds();
+
+    auto &header = headerOf(mapping);
+    uint64_t sequence = header.published.load(memory_order_relaxed);
+    Slot &slot = slotsOf(mapping)[sequence & (slotCount - 1)];
+
+    slot.version.store(2 * sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&slot.record, &record, usedBytes(record));
+    slot.version.store(2 * sequence + 2, memory_order_release);
+    header.published.store(sequence + 1, memory_order_release);
+}
+
+void ShmFeedPublisher::publishNotification(const json &params)
+{
+    if (!params.contains("channel") || !params.contains("data"))
+    {
+        return;
+    }
+
+    const string &channel = params["channel"].get_ref<const string &>();
+    if (channel.rfind("book.", 0) == 0)
+    {
+        publishBook(params["data"]);
+    }
+    else if (channel.rfind("ticker.", 0) == 0 || channel.rfind("quote.", 0) == 0)
+    {
+        publishBbo(params["data"]);
+    }
+}
+
+void ShmFeedPublisher::setSnapshotInterval(chrono::milliseconds interval)
+{
+    snapshotIntervalNs = chrono::duration_cast<chrono::nanoseconds>(interval).count();
+}
+
+void ShmFeedPublisher::publishBook(const json &data)
+{
+    string instrument = data.value("instrument_name", "");
+    if (instrument.empty())
+    {
+        return;
+    }
+
+    // Grouped books (book.X.depth.interval) carry full snapshots without a type
+    bool snapshot = data.value("type", "snapshot") == "snapshot";
+    beginBookRecord(instrument, snapshot ? FeedRecordType::BookSnapshot : FeedRecordType::BookUpdate,
+                    data.value("timestamp", int64_t(0)), data.value("change_id", int64_t(0)));
+
+    auto addSide = [&](const char *key, bool bid)
+    {
+        if (!data.contains(key))
+        {
+            return;
+        }
+        for (const auto &level : data[key])
+        {
+            // [action, price, amount] for incremental books, [price, amount] for grouped ones
+            if (level.size() >= 3 && level[0].is_string())
+            {
+                addLevel({level[1].get<double>(), level[0] == "delete" ? 0.0 : level[2].get<double>()}, bid);
+            }
+            else if (level.size() >= 2)
+            {
+                addLevel({level[0].get<double>(), level[1].get<double>()}, bid);
+            }
+        }
+    };
+    addSide("bids", true);
+    addSide("asks", false);
+    endBookRecord();
+
+    auto &published = books[instrument];
+    published.book.apply(data);
+    if (snapshot)
+    {
+        published.lastSnapshotNs = monotonicNanoseconds();
+    }
+    else
+    {
+        republishIfDue(instrument, published, monotonicNanoseconds());
+    }
+}
+
+void ShmFeedPublisher::publishDueSnapshots()
+{
+    int64_t now = monotonicNanoseconds();
+    for (auto &[instrument, published] : books)
+    {
+        republishIfDue(instrument, published, now);
+    }
+}
+
+void ShmFeedPublisher::republishIfDue(const string &instrument, PublishedBook &published, int64_t now)
+{
+    // A book with a change_id gap stays silent until the exchange sends a new snapshot
+    const LocalOrderBook &book = published.book;
+    if (snapshotIntervalNs <= 0 || !book.valid() || now - published.lastSnapshotNs < snapshotIntervalNs)
+    {
+        return;
+    }
+
+    beginBookRecord(instrument, FeedRecordType::BookSnapshot, book.lastTimestampMs(), book.lastChangeId());
+    for (const auto &[price, amount] : book.bidLevels())
+    {
+        addLevel({price, amount}, true);
+    }
+    for (const auto &[price, amount] : book.askLevels())
+    {
+        addLevel({price, amount}, false);
+    }
+    endBookRecord();
+    published.lastSnapshotNs = now;
+}
+
+void ShmFeedPublisher::beginBookRecord(const string &instrument, FeedRecordType type, int64_t timestampMs,
+                                       int64_t changeId)
+{
+    copyInstrument(scratch, instrument);
+    scratch.type = type;
+    scratch.exchangeTimestampMs = timestampMs;
+    scratch.changeId = changeId;
+    scratch.fragment = 0;
+    scratch.bidCount = 0;
+    scratch.askCount = 0;
+}
+
+void ShmFeedPublisher::addLevel(const FeedLevel &level, bool bid)
+{
+    if (scratch.levelCount() == kFeedMaxLevels)
+    {
+        scratch.lastFragment = false;
+        publish(scratch);
+        scratch.fragment++;
+        scratch.bidCount = 0;
+        scratch.askCount = 0;
+    }
+    scratch.levels[scratch.levelCount()] = level;
+    (bid ? scratch.bidCount : scratch.askCount)++;
+}
+
+void ShmFeedPublisher::endBookRecord()
+{
+    scratch.lastFragment = true;
+    publish(scratch);
+}
+
+void ShmFeedPublisher::publishBbo(const json &data)
+{
+    string instrument = data.value("instrument_name", "");
+    if (instrument.empty())
+    {
+        return;
+    }
+
+    copyInstrument(scratch, instrument);
+    scratch.type = FeedRecordType::Bbo;
+    scratch.exchangeTimestampMs = data.value("timestamp", int64_t(0));
+    scratch.changeId = 0;
+    scratch.fragment = 0;
+    scratch.lastFragment = true;
+    scratch.bidCount = 1;
+    scratch.askCount = 1;
+    scratch.levels[0] = {numberOr(data, "best_bid_price", 0.0), numberOr(data, "best_bid_amount", 0.0)};
+    scratch.levels[1] = {numberOr(data, "best_ask_price", 0.0), numberOr(data, "best_ask_amount", 0.0)};
+    publish(scratch);
+}
+
+ShmFeedReader::ShmFeedReader(const string &name, bool fromOldest)
+{
+#ifdef _WIN32
+    throw runtime_error("ShmFeedReader requires POSIX shared memory");
+#else
+    string path = segmentPath(name);
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        throw runtime_error("Cannot open feed segment " + path + ": " + strerror(errno));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(SegmentHeader))
+    {
+        ::close(fd);
+        throw runtime_error("Feed segment " + path + " is not initialised");
+    }
+    mappedBytes = size_t(info.st_size);
+
+    void *mapped = mmap(nullptr, mappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        throw runtime_error("Cannot map feed segment " + path + ": " + strerror(errno));
+    }
+    mapping = mapped;
+
+    const auto &header = headerOf(mapping);
+    if (header.magic != kMagic || header.version != kVersion || header.slotBytes != sizeof(Slot) ||
+        segmentBytes(header.capacity) > mappedBytes)
+    {
+        munmap(mapped, mappedBytes);
+        mapping = nullptr;
+        throw runtime_error("Feed segment " + path + " has an incompatible layout");
+    }
+    slotCount = header.capacity;
+
+    uint64_t head = header.published.load(memory_order_acquire);
+    nextSequence = head;
+    if (fromOldest)
+    {
+        nextSequence = head > slotCount ? head - slotCount : 0;
+    }
+#endif
+}
+
+ShmFeedReader::~ShmFeedReader()
+{
+#ifndef _WIN32
+    if (mapping)
+    {
+        munmap(const_cast<void *>(mapping), mappedBytes);
+    }
+#endif
+}
+
+bool ShmFeedReader::producerActive() const
+{
+    return headerOf(mapping).producerActive.load(memory_order_acquire) != 0;
+}
+
+void ShmFeedReader::skipToLatest()
+{
+    nextSequence = headerOf(mapping).published.load(memory_order_acquire);
+}
+
+void ShmFeedReader::lapped(uint64_t head)
+{
+    laps++;
+    missed += head > nextSequence ? head - nextSequence : 1;
+    nextSequence = head;
+}
+
+FeedReadResult ShmFeedReader::poll(FeedRecord &out)
+{
+    const auto &header = headerOf(mapping);
+    uint64_t head = header.published.load(memory_order_acquire);
+    if (nextSequence >= head)
+    {
+        return FeedReadResult::Empty;
+    }
+    if (head - nextSequence > slotCount)
+    {
+        lapped(head);
+        return FeedReadResult::Lapped;
+    }
+
+    const Slot &slot = slotsOf(mapping)[nextSequence & (slotCount - 1)];
+    uint64_t expected = 2 * nextSequence + 2;
+    uint64_t before = slot.version.load(memory_order_acquire);
+    if (before != expected)
+    {
+        // Already reused for a later sequence
+        lapped(header.published.load(memory_order_acquire));
+        return FeedReadResult::Lapped;
+    }
+
+    // Level counts may be torn if the slot is being rewritten; the version
+    // check below discards the copy in that case
+    memcpy(&out, &slot.record, kRecordHeaderBytes);
+    memcpy(out.levels, slot.record.levels, min(out.levelCount(), kFeedMaxLevels) * sizeof(FeedLevel));
+    atomic_thread_fence(memory_order_acquire);
+    if (slot.version.load(memory_order_relaxed) != before)
+    {
+        lapped(header.published.load(memory_order_acquire));
+        return FeedReadResult::Lapped;
+    }
+
+    nextSequence++;
+    return FeedReadResult::Record;
+}
@@ -0,0 +1,156 @@
+#ifndef SHM_FEED_HPP
+#define SHM_FEED_HPP
+
+#include "order_book.hpp"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using namespace std;
+using json = nlohmann::json;
+
+enum class FeedRecordType : uint8_t
+{
+    BookSnapshot,
+    BookUpdate,
+    Bbo
+};
+
+struct FeedLevel
+{
+    double price;
+    double amount; // 0 removes the level
+};
+
+constexpr size_t kFeedMaxLevels = 32;
+constexpr size_t kFeedInstrumentLength = 32;
+
+// One slot of the ring. Book messages with more levels than fit are split
+// into fragments sharing changeId; only the last has lastFragment set, and
+// fragments after the first never clear the book. Bids come first in levels,
+// followed by asks. A Bbo record holds one bid and one ask.
+struct FeedRecord
+{
+    int64_t exchangeTimestampMs;
+    int64_t publishMonotonicNs; // CLOCK_MONOTONIC, comparable across processes
+    int64_t changeId;
+    char instrument[kFeedInstrumentLength];
+    FeedRecordType type;
+    bool lastFragment;
+    uint16_t fragment;
+    uint16_t bidCount;
+    uint16_t askCount;
+    FeedLevel levels[kFeedMaxLevels];
+
+    string_view instrumentName() const { return string_view(instrument); }
+    const FeedLevel *bids() const { return levels; }
+    const FeedLevel *asks() const { return levels + bidCount; }
+    size_t levelCount() const { return size_t(bidCount) + askCount; }
+};
+
+enum class FeedReadResult
+{
+    Record,
+    Empty,
+    Lapped
+};
+
+// Single-producer ring in POSIX shared memory. Every slot carries a sequence
+// lock: the publisher writes 2*seq+1 before touching the record and 2*seq+2
+// after, so a reader that sees the same even version before and after its
+// copy knows the record is whole. Readers map the segment read-only and keep
+// their own cursor; nothing they do is visible to the publisher or each other.
+//
+// The publisher keeps a book per instrument from the notifications it
+// decodes and republishes it whole as a BookSnapshot every snapshot
+// interval, so a reader that attaches late or was lapped recovers at the
+// next one instead of waiting for the exchange to resend a snapshot.
+class ShmFeedPublisher
+{
+public:
+    // Capacity is rounded up to a power of two. Any stale segment with the
+    // same name is replaced; readers attached to it keep the old mapping.
+    explicit ShmFeedPublisher(const string &name, size_t capacity = 16384);
+    ~ShmFeedPublisher();
+
+    ShmFeedPublisher(const ShmFeedPublisher &) = delete;
+    ShmFeedPublisher &operator=(const ShmFeedPublisher &) = delete;
+
+    // Stamps publishMonotonicNs and copies the used part of the record in
+    void publish(FeedRecord &record);
+
+    // Decodes a book / ticker / quote subscription notification ({"channel", "data"})
+    void publishNotification(const json &params);
+
+    // How often each book is republished as a snapshot; zero turns it off
+    void setSnapshotInterval(chrono::milliseconds interval);
+    // Books are checked as their updates are published; call this between
+    // reads so quiet instruments get their snapshots too
+    void publishDueSnapshots();
+
+    uint64_t publishedCount() const;
+    size_t capacity() const { return slotCount; }
+    const string &name() const { return segmentName; }
+
+private:
+    string segmentName;
+    size_t slotCount;
+    size_t mappedBytes = 0;
+    void *mapping = nullptr;
+    FeedRecord scratch{};
+
+    struct PublishedBook
+    {
+        LocalOrderBook book;
+        int64_t lastSnapshotNs = 0;
+    };
+    unordered_map<string, PublishedBook> books;
+    int64_t snapshotIntervalNs = 1000000000;
+
+    void publishBook(const json &data);
+    void publishBbo(const json &data);
+    void republishIfDue(const string &instrument, PublishedBook &published, int64_t now);
+    void beginBookRecord(const string &instrument, FeedRecordType type, int64_t timestampMs, int64_t changeId);
+    void addLevel(const FeedLevel &level, bool bid);
+    void endBookRecord();
+};
+
+class ShmFeedReader
+{
+public:
+    // Attaches at the newest record; pass fromOldest to replay what is still in the ring
+    explicit ShmFeedReader(const string &name, bool fromOldest = false);
+    ~ShmFeedReader();
+
+    ShmFeedReader(const ShmFeedReader &) = delete;
+    ShmFeedReader &operator=(const ShmFeedReader &) = delete;
+
+    // Lapped means the publisher overwrote records this reader had not seen
+    // yet; the cursor has been moved to the newest record. Books should be
+    // dropped and rebuilt from the next BookSnapshot, which the publisher
+    // sends at least once per snapshot interval.
+    FeedReadResult poll(FeedRecord &out);
+
+    void skipToLatest();
+    bool producerActive() const;
+
+    uint64_t cursor() const { return nextSequence; }
+    uint64_t lappedCount() const { return laps; }
+    uint64_t missedRecords() const { return missed; }
+
+private:
+    size_t mappedBytes = 0;
+    const void *mapping = nullptr;
+    size_t slotCount = 0;
+    uint64_t nextSequence = 0;
+    uint64_t laps = 0;
+    uint64_t missed = 0;
+
+    void lapped(uint64_t head);
+};
+
+#endif
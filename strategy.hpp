@@ -0,0 +1,128 @@
+#ifndef STRATEGY_HPP
+#define STRATEGY_HPP
+
+#include "order_types.hpp"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+// Everything a strategy compiled as a shared object needs; it must only
+// depend on header-only code so the plugin does not link against the host.
+
+struct PriceLevel
+{
+    double price;
+    double amount; // 0 means the level was deleted
+};
+
+struct LevelSpan
+{
+    const PriceLevel *levels = nullptr;
+    size_t count = 0;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const PriceLevel &operator[](size_t i) const { return levels[i]; }
+    const PriceLevel *begin() const { return levels; }
+    const PriceLevel *end() const { return levels + count; }
+};
+
+// Views borrow from the decoded message and are only valid during the callback.
+struct BookView
+{
+    string_view instrument;
+    string_view channel;
+    int64_t timestampMs;
+    int64_t changeId;
+    bool snapshot;
+    LevelSpan bids;
+    LevelSpan asks;
+    const json &raw;
+};
+
+struct TradeView
+{
+    string_view instrument;
+    string_view tradeId;
+    double price;
+    double amount;
+    bool buyerInitiated;
+    int64_t timestampMs;
+    const json &raw;
+};
+
+struct OrderView
+{
+    int requestId; // set on the direct reply to an OrderSink call, 0 for feed updates
+    string_view orderId;
+    string_view instrument;
+    string_view state; // open, filled, rejected, cancelled, untriggered
+    string_view direction;
+    string_view label;
+    double price;
+    double amount;
+    double filledAmount;
+    const json &raw;
+};
+
+struct FillView
+{
+    string_view tradeId;
+    string_view orderId;
+    string_view instrument;
+    string_view direction;
+    double price;
+    double amount;
+    double fee;
+    int64_t timestampMs;
+    const json &raw;
+};
+
+// Orders go straight onto the socket from the calling thread. The returned
+// request id matches the OrderView delivered when the exchange replies.
+class OrderSink
+{
+public:
+    virtual ~OrderSink() = default;
+    virtual int placeOrder(const string &instrument, OrderSide side, double amount, double price) = 0;
+    virtual int amendOrder(const string &orderId, double newPrice, double newAmount) = 0;
+    virtual int cancelOrder(const string &orderId) = 0;
+};
+
+class Strategy
+{
+public:
+    virtual ~Strategy() = default;
+
+    virtual string name() const = 0;
+    virtual vector<string> channels() const = 0;
+    virtual chrono::milliseconds timerInterval() const { return chrono::milliseconds(0); }
+
+    virtual void onStart() {}
+    virtual void onBook(const BookView &) {}
+    virtual void onTrade(const TradeView &) {}
+    virtual void onOrderUpdate(const OrderView &) {}
+    virtual void onFill(const FillView &) {}
+    virtual void onTimer(int64_t /*monotonicNs*/) {}
+
+protected:
+    OrderSink &orders() { return *sink; }
+
+private:
+    friend class StrategyHost;
+    OrderSink *sink = nullptr;
+};
+
+#define DERIBIT_STRATEGY_CREATE_SYMBOL "deribit_create_strategy"
+#define DERIBIT_STRATEGY_DESTROY_SYMBOL "deribit_destroy_strategy"
+
+#define DERIBIT_EXPORT_STRATEGY(StrategyType)                                            \
+    extern "C" Strategy *deribit_create_strategy() { return new StrategyType(); }        \
+    extern "C" void deribit_destroy_strategy(Strategy *strategy) { delete strategy; }
+
+#endif
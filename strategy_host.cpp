@@ -0,0 +1,479 @@
+#include "strategy_host.hpp"
+#include <iostream>
+#include <stdexcept>
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+using namespace std;
+
+namespace
+{
+    const string kOrderChannel = "user.orders.any.any.raw";
+    const string kFillChannel = "user.trades.any.any.raw";
+    // Longest a read blocks when no timer is due, so a cleared run flag is noticed
+    constexpr chrono::milliseconds kIdlePoll{100};
+
+    string_view textField(const json &object, const char *key)
+    {
+        auto it = object.find(key);
+        if (it == object.end() || !it->is_string())
+        {
+            return {};
+        }
+        return it->get_ref<const string &>();
+    }
+
+    double numberField(const json &object, const char *key)
+    {
+        auto it = object.find(key);
+        return it != object.end() && it->is_number() ? it->get<double>() : 0.0;
+    }
+
+    int64_t integerField(const json &object, const char *key)
+    {
+        auto it = object.find(key);
+        return it != object.end() && it->is_number() ? it->get<int64_t>() : 0;
+    }
+
+    bool startsWith(const string &text, const string &prefix)
+    {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    }
+}
+
+StrategyHost::StrategySlot::StrategySlot(StrategyHost &host, Strategy *strategy,
+                                         void (*destroy)(Strategy *), void *library)
+    : strategy(strategy), host(host), destroy(destroy), library(library)
+{
+    strategy->sink = this;
+    label = strategy->name();
+}
+
+StrategyHost::StrategySlot::~StrategySlot()
+{
+    if (destroy)
+    {
+        destroy(strategy);
+    }
+    else
+    {
+        delete strategy;
+    }
+#ifndef _WIN32
+    if (library)
+    {
+        dlclose(library);
+    }
+#endif
+}
+
+int StrategyHost::StrategySlot::placeOrder(const string &instrument, OrderSide side, double amount, double price)
+{
+    auto alive = host.alive;
+    return host.market.submitOrderAsync(instrument, side, amount, price, label,
+                                        [this, alive](const json &response)
+                                        {
+                                            if (*alive)
+                                            {
+                                                deliverReply(response["id"].get<int>(), response);
+                                            }
+                                        });
+}
+
+int StrategyHost::StrategySlot::amendOrder(const string &orderId, double newPrice, double newAmount)
+{
+    auto alive = host.alive;
+    return host.market.adjustOrderAsync(orderId, newPrice, newAmount,
+                                        [this, alive](const json &response)
+                                        {
+                                            if (*alive)
+                                            {
+                                                deliverReply(response["id"].get<int>(), response);
+                                            }
+                                        });
+}
+
+int StrategyHost::StrategySlot::cancelOrder(const string &orderId)
+{
+    auto alive = host.alive;
+    return host.market.removeOrderAsync(orderId,
+                                        [this, alive](const json &response)
+                                        {
+                                            if (*alive)
+                                            {
+                                                deliverReply(response["id"].get<int>(), response);
+                                            }
+                                        });
+}
+
+void StrategyHost::StrategySlot::deliverReply(int requestId, const json &response)
+{
+    if (response.contains("error"))
+    {
+        OrderView view{requestId, {}, {}, "rejected", {}, label, 0.0, 0.0, 0.0, response};
+        strategy->onOrderUpdate(view);
+        return;
+    }
+
+    const json &result = response["result"];
+    const json &order = result.contains("order") ? result["order"] : result;
+    strategy->onOrderUpdate(makeOrderView(order, requestId));
+}
+
+StrategyHost::StrategyHost(MarketOperations &market)
+    : market(market), alive(make_shared<bool>(true)) {}
+
+StrategyHost::~StrategyHost()
+{
+    *alive = false;
+    stop();
+}
+
+void StrategyHost::addStrategy(unique_ptr<Strategy> strategy)
+{
+    addSlot(make_unique<StrategySlot>(*this, strategy.release(), nullptr, nullptr));
+}
+
+void StrategyHost::loadStrategy(const string &libraryPath)
+{
+#ifdef _WIN32
+    throw runtime_error("Loading strategies from shared objects is not supported on Windows");
+#else
+    void *library = dlopen(libraryPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!library)
+    {
+        throw runtime_error("Failed to load strategy " + libraryPath + ": " + dlerror());
+    }
+
+    auto create = reinterpret_cast<Strategy *(*)()>(dlsym(library, DERIBIT_STRATEGY_CREATE_SYMBOL));
+    auto destroy = reinterpret_cast<void (*)(Strategy *)>(dlsym(library, DERIBIT_STRATEGY_DESTROY_SYMBOL));
+    if (!create || !destroy)
+    {
+        dlclose(library);
+        throw runtime_error(libraryPath + " does not export " DERIBIT_STRATEGY_CREATE_SYMBOL
+                                          " and " DERIBIT_STRATEGY_DESTROY_SYMBOL);
+    }
+
+    Strategy *strategy = create();
+    if (!strategy)
+    {
+        dlclose(library);
+        throw runtime_error(libraryPath + " returned no strategy");
+    }
+    addSlot(make_unique<StrategySlot>(*this, strategy, destroy, library));
+#endif
+}
+
+void StrategyHost::addSlot(unique_ptr<StrategySlot> slot)
+{
+    if (started)
+    {
+        throw logic_error("Strategies must be added before the host is started");
+    }
+
+    // Order updates and fills are routed by label, so it has to be unique
+    StrategySlot *raw = slot.get();
+    if (!labelRoutes.emplace(raw->label, raw).second)
+    {
+        throw invalid_argument("A strategy named " + raw->label + " is already loaded");
+    }
+    for (const auto &channel : raw->strategy->channels())
+    {
+        channelRoutes[channel].push_back(raw);
+    }
+    slots.push_back(move(slot));
+}
+
+void StrategyHost::start()
+{
+    if (started)
+    {
+        return;
+    }
+
+    // One subscription per channel however many strategies share it
+    vector<string> channels;
+    channels.reserve(channelRoutes.size() + 2);
+    for (const auto &[channel, targets] : channelRoutes)
+    {
+        channels.push_back(channel);
+    }
+    channels.push_back(kOrderChannel);
+    channels.push_back(kFillChannel);
+
+    auto alive = this->alive;
+    try
+    {
+        subscription = market.subscriptionManager().subscribe(channels, [this, alive](const json &params)
+                                                              {
+                                                                  if (*alive)
+                                                                  {
+                                                                      onChannelMessage(params);
+                                                                  }
+                                                              });
+    }
+    catch (const SubscriptionError &e)
+    {
+        // Drop whatever batches did go through before reporting the failure
+        try
+        {
+            market.subscriptionManager().unsubscribe(e.id);
+        }
+        catch (const exception &cleanup)
+        {
+            cerr << "Strategy host unsubscribe failed: " << cleanup.what() << endl;
+        }
+        throw;
+    }
+    started = true;
+
+    TscClock::ticks now = TscClock::now();
+    for (auto &slot : slots)
+    {
+        auto interval = slot->strategy->timerInterval();
+        if (interval.count() > 0)
+        {
+            double nanoseconds = double(chrono::duration_cast<chrono::nanoseconds>(interval).count());
+            slot->timerPeriod = static_cast<TscClock::ticks>(nanoseconds * TscClock::ticksPerNanosecond());
+            slot->nextTimer = now + slot->timerPeriod;
+        }
+        slot->strategy->onStart();
+    }
+}
+
+void StrategyHost::run(const atomic<bool> &running)
+{
+    start();
+
+    // Reads give up when the next timer is due, so timers keep their
+    // schedule on quiet channels too.
+    while (running.load(memory_order_relaxed))
+    {
+        market.pollMarketData(untilNextTimer());
+        fireTimers();
+    }
+}
+
+void StrategyHost::stop()
+{
+    if (!started)
+    {
+        return;
+    }
+
+    try
+    {
+        market.subscriptionManager().unsubscribe(subscription);
+    }
+    catch (const exception &e)
+    {
+        cerr << "Strategy host unsubscribe failed: " << e.what() << endl;
+    }
+    subscription = 0;
+    started = false;
+}
+
+void StrategyHost::onChannelMessage(const json &params)
+{
+    const string &channel = params["channel"].get_ref<const string &>();
+    const json &data = params["data"];
+
+    if (channel == kOrderChannel)
+    {
+        if (data.is_array())
+        {
+            for (const auto &order : data)
+            {
+                routeOrder(order, 0);
+            }
+        }
+        else
+        {
+            routeOrder(data, 0);
+        }
+        return;
+    }
+    if (channel == kFillChannel)
+    {
+        for (const auto &trade : data)
+        {
+            routeFill(trade);
+        }
+        return;
+    }
+
+    auto it = channelRoutes.find(channel);
+    if (it == channelRoutes.end())
+    {
+        return;
+    }
+
+    if (startsWith(channel, "book."))
+    {
+        routeBook(channel, data, it->second);
+    }
+    else if (startsWith(channel, "trades."))
+    {
+        routeTrades(data, it->second);
+    }
+}
+
+void StrategyHost::routeBook(const string &channel, const json &data, const vector<StrategySlot *> &targets)
+{
+    decodeLevels(data["bids"], bidScratch);
+    decodeLevels(data["asks"], askScratch);
+
+    string_view type = textField(data, "type");
+    BookView view{
+        textField(data, "instrument_name"),
+        channel,
+        integerField(data, "timestamp"),
+        integerField(data, "change_id"),
+        type.empty() || type == "snapshot",
+        LevelSpan{bidScratch.data(), bidScratch.size()},
+        LevelSpan{askScratch.data(), askScratch.size()},
+        data};
+
+    for (auto *slot : targets)
+    {
+        slot->strategy->onBook(view);
+    }
+}
+
+void StrategyHost::routeTrades(const json &data, const vector<StrategySlot *> &targets)
+{
+    for (const auto &trade : data)
+    {
+        TradeView view{
+            textField(trade, "instrument_name"),
+            textField(trade, "trade_id"),
+            numberField(trade, "price"),
+            numberField(trade, "amount"),
+            textField(trade, "direction") == "buy",
+            integerField(trade, "timestamp"),
+            trade};
+
+        for (auto *slot : targets)
+        {
+            slot->strategy->onTrade(view);
+        }
+    }
+}
+
+void StrategyHost::routeOrder(const json &order, int requestId)
+{
+    OrderView view = makeOrderView(order, requestId);
+
+    auto owner = labelRoutes.find(string(view.label));
+    if (owner != labelRoutes.end())
+    {
+        owner->second->strategy->onOrderUpdate(view);
+        return;
+    }
+    for (auto &slot : slots)
+    {
+        slot->strategy->onOrderUpdate(view);
+    }
+}
+
+void StrategyHost::routeFill(const json &trade)
+{
+    FillView view{
+        textField(trade, "trade_id"),
+        textField(trade, "order_id"),
+        textField(trade, "instrument_name"),
+        textField(trade, "direction"),
+        numberField(trade, "price"),
+        numberField(trade, "amount"),
+        numberField(trade, "fee"),
+        integerField(trade, "timestamp"),
+        trade};
+
+    auto owner = labelRoutes.find(string(textField(trade, "label")));
+    if (owner != labelRoutes.end())
+    {
+        owner->second->strategy->onFill(view);
+        return;
+    }
+    for (auto &slot : slots)
+    {
+        slot->strategy->onFill(view);
+    }
+}
+
+void StrategyHost::fireTimers()
+{
+    TscClock::ticks now = TscClock::now();
+    for (auto &slot : slots)
+    {
+        if (slot->timerPeriod == 0 || now < slot->nextTimer)
+        {
+            continue;
+        }
+
+        slot->nextTimer += slot->timerPeriod;
+        if (slot->nextTimer <= now)
+        {
+            slot->nextTimer = now + slot->timerPeriod;
+        }
+        slot->strategy->onTimer(TscClock::toMonotonicNanoseconds(now));
+    }
+}
+
+chrono::milliseconds StrategyHost::untilNextTimer() const
+{
+    TscClock::ticks now = TscClock::now();
+    chrono::milliseconds wait = kIdlePoll;
+    for (const auto &slot : slots)
+    {
+        if (slot->timerPeriod == 0)
+        {
+            continue;
+        }
+        if (slot->nextTimer <= now)
+        {
+            return chrono::milliseconds(0);
+        }
+        double nanoseconds = double(slot->nextTimer - now) / TscClock::ticksPerNanosecond();
+        wait = min(wait, chrono::milliseconds(static_cast<int64_t>(nanoseconds / 1e6) + 1));
+    }
+    return wait;
+}
+
+void StrategyHost::decodeLevels(const json &side, vector<PriceLevel> &out)
+{
+    out.clear();
+    if (!side.is_array())
+    {
+        return;
+    }
+
+    // Incremental feeds send [action, price, amount]; grouped books send [price, amount]
+    for (const auto &level : side)
+    {
+        if (level.size() >= 3 && level[0].is_string())
+        {
+            double amount = level[0] == "delete" ? 0.0 : level[2].get<double>();
+            out.push_back(PriceLevel{level[1].get<double>(), amount});
+        }
+        else if (level.size() >= 2)
+        {
+            out.push_back(PriceLevel{level[0].get<double>(), level[1].get<double>()});
+        }
+    }
+}
+
+OrderView StrategyHost::makeOrderView(const json &order, int requestId)
+{
+    return OrderView{
+        requestId,
+        textField(order, "order_id"),
+        textField(order, "instrument_name"),
+        textField(order, "order_state"),
+        textField(order, "direction"),
+        textField(order, "label"),
+        numberField(order, "price"),
+        numberField(order, "amount"),
+        numberField(order, "filled_amount"),
+        order};
+}
@@ -0,0 +1,79 @@
+#ifndef STRATEGY_HOST_HPP
+#define STRATEGY_HOST_HPP
+
+#include "strategy.hpp"
+#include "market_operations.hpp"
+#include "tsc_clock.hpp"
+#include <memory>
+#include <unordered_map>
+#include <atomic>
+
+using namespace std;
+
+// Runs strategies in-process on the I/O thread. Every callback fires on the
+// thread that decoded the frame, and orders a strategy emits are written to
+// the socket before its callback returns.
+class StrategyHost
+{
+public:
+    explicit StrategyHost(MarketOperations &market);
+    ~StrategyHost();
+
+    StrategyHost(const StrategyHost &) = delete;
+    StrategyHost &operator=(const StrategyHost &) = delete;
+
+    void addStrategy(unique_ptr<Strategy> strategy);
+    void loadStrategy(const string &libraryPath);
+
+    void start();
+    void run(const atomic<bool> &running);
+    void stop();
+
+private:
+    class StrategySlot : public OrderSink
+    {
+    public:
+        StrategySlot(StrategyHost &host, Strategy *strategy, void (*destroy)(Strategy *), void *library);
+        ~StrategySlot() override;
+
+        int placeOrder(const string &instrument, OrderSide side, double amount, double price) override;
+        int amendOrder(const string &orderId, double newPrice, double newAmount) override;
+        int cancelOrder(const string &orderId) override;
+
+        Strategy *strategy;
+        string label;
+        TscClock::ticks timerPeriod = 0;
+        TscClock::ticks nextTimer = 0;
+
+    private:
+        StrategyHost &host;
+        void (*destroy)(Strategy *);
+        void *library;
+
+        void deliverReply(int requestId, const json &response);
+    };
+
+    MarketOperations &market;
+    shared_ptr<bool> alive; // replies can outlive the host; handlers check this first
+    vector<unique_ptr<StrategySlot>> slots;
+    unordered_map<string, vector<StrategySlot *>> channelRoutes;
+    unordered_map<string, StrategySlot *> labelRoutes;
+    SubscriptionId subscription = 0;
+    vector<PriceLevel> bidScratch;
+    vector<PriceLevel> askScratch;
+    bool started = false;
+
+    void addSlot(unique_ptr<StrategySlot> slot);
+    void onChannelMessage(const json &params);
+    void routeBook(const string &channel, const json &data, const vector<StrategySlot *> &targets);
+    void routeTrades(const json &data, const vector<StrategySlot *> &targets);
+    void routeOrder(const json &order, int requestId);
+    void routeFill(const json &trade);
+    void fireTimers();
+    chrono::milliseconds untilNextTimer() const;
+
+    static void decodeLevels(const json &side, vector<PriceLevel> &out);
+    static OrderView makeOrderView(const json &order, int requestId);
+};
+
+#endif
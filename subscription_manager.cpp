@@ -0,0 +1,430 @@
+#include "subscription_manager.hpp"
+#include "trade_tracer.hpp"
+#include <algorithm>
+#include <stdexcept>
+using namespace std;
+
+SubscriptionManager::SubscriptionManager(RequestSender sender, size_t maxChannelsPerRequest)
+    : sendRequest(move(sender)),
+      batchSize(max<size_t>(1, maxChannelsPerRequest)) {}
+
+string SubscriptionManager::intervalName(ChannelInterval interval)
+{
+    switch (interval)
+    {
+    case ChannelInterval::Raw:
+        return "raw";
+    case ChannelInterval::Agg2:
+        return "agg2";
+    case ChannelInterval::Ms100:
+    default:
+        return "100ms";
+    }
+}
+
+string SubscriptionManager::bookChannel(const string &instrument, ChannelInterval interval)
+{
+    return "book." + instrument + "." + intervalName(interval);
+}
+
+string SubscriptionManager::bookSnapshotChannel(const string &instrument, int depth,
+                                                ChannelInterval interval, const string &group)
+{
+    return "book." + instrument + "." + group + "." + to_string(depth) + "." + intervalName(interval);
+}
+
+string SubscriptionManager::tickerChannel(const string &instrument, ChannelInterval interval)
+{
+    return "ticker." + instrument + "." + intervalName(interval);
+}
+
+string SubscriptionManager::tradesChannel(const string &instrument, ChannelInterval interval)
+{
+    return "trades." + instrument + "." + intervalName(interval);
+}
+
+SubscriptionId SubscriptionManager::subscribe(const vector<string> &channels, ChannelCallback callback,
+                                              DeliveryMode mode)
+{
+    if (mode == DeliveryMode::Conflated)
+    {
+        for (const auto &channel : channels)
+        {
+            if (!isSnapshotChannel(channel))
+            {
+                throw invalid_argument("Cannot conflate " + channel +
+                                       "; only snapshot channels (ticker, quote, book snapshots) keep state");
+            }
+        }
+    }
+
+    vector<string> requested(channels);
+    sort(requested.begin(), requested.end());
+    requested.erase(unique(requested.begin(), requested.end()), requested.end());
+
+    auto shared = make_shared<const ChannelCallback>(move(callback));
+    SubscriptionId id;
+    vector<string> firstSubscribers;
+    {
+        // Handlers go in before the request so notifications that race the
+        // subscribe response are not dropped.
+        lock_guard<mutex> lock(stateMutex);
+        id = nextSubscriptionId++;
+        for (const auto &channel : requested)
+        {
+            auto &state = channelStates[channel];
+            state.subscribers.push_back(Subscriber{id, shared, mode, json(), false});
+            rebuild(state);
+            if (!state.live)
+            {
+                firstSubscribers.push_back(channel);
+            }
+        }
+        subscriptionChannels[id] = requested;
+    }
+    if (resetObserver && !firstSubscribers.empty())
+    {
+        resetObserver(firstSubscribers);
+    }
+
+    vector<string> confirmed;
+    try
+    {
+        sendBatched("subscribe", firstSubscribers, &confirmed);
+    }
+    catch (const exception &e)
+    {
+        settleSubscribe(id, firstSubscribers, confirmed);
+        throw SubscriptionError(id, e.what());
+    }
+    settleSubscribe(id, firstSubscribers, confirmed);
+    return id;
+}
+
+void SubscriptionManager::settleSubscribe(SubscriptionId id, const vector<string> &requested,
+                                          const vector<string> &confirmed)
+{
+    lock_guard<mutex> lock(stateMutex);
+    auto owned = subscriptionChannels.find(id);
+    for (const auto &channel : requested)
+    {
+        auto state = channelStates.find(channel);
+        if (state == channelStates.end())
+        {
+            continue;
+        }
+        if (find(confirmed.begin(), confirmed.end(), channel) != confirmed.end())
+        {
+            state->second.live = true;
+            continue;
+        }
+
+        // Not registered by the exchange, so this subscription does not get it
+        auto &subscribers = state->second.subscribers;
+        subscribers.erase(remove_if(subscribers.begin(), subscribers.end(),
+                                    [id](const Subscriber &subscriber)
+                                    { return subscriber.id == id; }),
+                          subscribers.end());
+        rebuild(state->second);
+        if (subscribers.empty() && !state->second.live)
+        {
+            channelStates.erase(state);
+        }
+        if (owned != subscriptionChannels.end())
+        {
+            auto &list = owned->second;
+            list.erase(remove(list.begin(), list.end(), channel), list.end());
+        }
+    }
+    if (owned != subscriptionChannels.end() && owned->second.empty())
+    {
+        subscriptionChannels.erase(owned);
+    }
+}
+
+void SubscriptionManager::unsubscribe(SubscriptionId id)
+{
+    vector<string> lastSubscriber;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        auto owned = subscriptionChannels.find(id);
+        if (owned == subscriptionChannels.end())
+        {
+            return;
+        }
+        for (const auto &channel : owned->second)
+        {
+            auto state = channelStates.find(channel);
+            if (state == channelStates.end())
+            {
+                continue;
+            }
+            auto &subscribers = state->second.subscribers;
+            subscribers.erase(remove_if(subscribers.begin(), subscribers.end(),
+                                        [id](const Subscriber &subscriber)
+                                        { return subscriber.id == id; }),
+                              subscribers.end());
+            rebuild(state->second);
+            if (subscribers.empty())
+            {
+                if (state->second.live)
+                {
+                    lastSubscriber.push_back(channel);
+                }
+                channelStates.erase(state);
+            }
+        }
+        subscriptionChannels.erase(owned);
+    }
+    releaseChannels(lastSubscriber);
+}
+
+void SubscriptionManager::unsubscribeAll()
+{
+    vector<string> live;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        for (const auto &[channel, state] : channelStates)
+        {
+            if (state.live)
+            {
+                live.push_back(channel);
+            }
+        }
+        channelStates.clear();
+        subscriptionChannels.clear();
+    }
+    releaseChannels(live);
+}
+
+void SubscriptionManager::releaseChannels(const vector<string> &channels)
+{
+    if (channels.empty())
+    {
+        return;
+    }
+
+    // Local state is already gone, so notifications still in flight are ignored
+    sendBatched("unsubscribe", channels, nullptr);
+    if (resetObserver)
+    {
+        resetObserver(channels);
+    }
+
+    // A subscriber that arrived while the request was out may have had its
+    // subscribe overtaken by this unsubscribe; subscribing again is harmless
+    vector<string> resubscribe;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        for (const auto &channel : channels)
+        {
+            auto state = channelStates.find(channel);
+            if (state != channelStates.end() && state->second.live)
+            {
+                resubscribe.push_back(channel);
+            }
+        }
+    }
+    if (!resubscribe.empty())
+    {
+        sendBatched("subscribe", resubscribe, nullptr);
+    }
+}
+
+void SubscriptionManager::setObserver(ChannelCallback callback)
+{
+    observer = move(callback);
+}
+
+void SubscriptionManager::setResetObserver(ChannelListCallback callback)
+{
+    resetObserver = move(callback);
+}
+
+bool SubscriptionManager::dispatch(json params)
+{
+    if (!params.contains("channel"))
+    {
+        return false;
+    }
+
+    shared_ptr<const CallbackList> immediate;
+    bool conflated;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        auto it = channelStates.find(params["channel"].get_ref<const string &>());
+        if (it == channelStates.end() || it->second.subscribers.empty())
+        {
+            return false;
+        }
+        immediate = it->second.immediate;
+        conflated = it->second.anyConflated;
+    }
+
+    if (observer)
+    {
+        observer(params);
+    }
+
+    if (conflated)
+    {
+        lock_guard<mutex> lock(stateMutex);
+        auto it = channelStates.find(params["channel"].get_ref<const string &>());
+        if (it != channelStates.end())
+        {
+            for (auto &subscriber : it->second.subscribers)
+            {
+                if (subscriber.mode != DeliveryMode::Conflated)
+                {
+                    continue;
+                }
+                if (subscriber.hasPending)
+                {
+                    conflatedDrops.fetch_add(1, memory_order_relaxed);
+                }
+                subscriber.pending = params;
+                subscriber.hasPending = true;
+            }
+        }
+    }
+
+    if (immediate && !immediate->empty())
+    {
+        TradeTracer::stamp(TraceStage::Dispatch);
+        for (const auto &callback : *immediate)
+        {
+            (*callback)(params);
+        }
+    }
+    return true;
+}
+
+size_t SubscriptionManager::drainConflated()
+{
+    vector<pair<shared_ptr<const ChannelCallback>, json>> ready;
+    {
+        lock_guard<mutex> lock(stateMutex);
+        for (auto &[channel, state] : channelStates)
+        {
+            for (auto &subscriber : state.subscribers)
+            {
+                if (subscriber.hasPending)
+                {
+                    ready.emplace_back(subscriber.callback, move(subscriber.pending));
+                    subscriber.hasPending = false;
+                }
+            }
+        }
+    }
+
+    for (const auto &[callback, params] : ready)
+    {
+        (*callback)(params);
+    }
+    return ready.size();
+}
+
+vector<string> SubscriptionManager::channels(SubscriptionId id) const
+{
+    lock_guard<mutex> lock(stateMutex);
+    auto owned = subscriptionChannels.find(id);
+    return owned != subscriptionChannels.end() ? owned->second : vector<string>();
+}
+
+bool SubscriptionManager::isSubscribed(const string &channel) const
+{
+    lock_guard<mutex> lock(stateMutex);
+    auto it = channelStates.find(channel);
+    return it != channelStates.end() && it->second.live && !it->second.subscribers.empty();
+}
+
+vector<string> SubscriptionManager::activeChannels() const
+{
+    lock_guard<mutex> lock(stateMutex);
+    vector<string> active;
+    active.reserve(channelStates.size());
+    for (const auto &[channel, state] : channelStates)
+    {
+        if (state.live && !state.subscribers.empty())
+        {
+            active.push_back(channel);
+        }
+    }
+    return active;
+}
+
+void SubscriptionManager::rebuild(ChannelState &state)
+{
+    auto immediate = make_shared<CallbackList>();
+    state.anyConflated = false;
+    for (const auto &subscriber : state.subscribers)
+    {
+        if (subscriber.mode == DeliveryMode::Conflated)
+        {
+            state.anyConflated = true;
+        }
+        else
+        {
+            immediate->push_back(subscriber.callback);
+        }
+    }
+    state.immediate = move(immediate);
+}
+
+bool SubscriptionManager::requiresPrivateScope(const string &channel)
+{
+    // Deribit only serves raw feeds and user.* channels on an authorized session.
+    const string rawSuffix = ".raw";
+    bool isRaw = channel.size() >= rawSuffix.size() &&
+                 channel.compare(channel.size() - rawSuffix.size(), rawSuffix.size(), rawSuffix) == 0;
+    return isRaw || channel.rfind("user.", 0) == 0;
+}
+
+bool SubscriptionManager::isSnapshotChannel(const string &channel)
+{
+    // Each notification on these replaces the previous one. book.X.group.depth.interval
+    // is a snapshot, book.X.interval a delta.
+    static const char *snapshotPrefixes[] = {"ticker.", "quote.", "deribit_price_index.",
+                                             "deribit_volatility_index.", "estimated_expiration_price.",
+                                             "markprice.options.", "perpetual."};
+    for (const char *prefix : snapshotPrefixes)
+    {
+        if (channel.rfind(prefix, 0) == 0)
+        {
+            return true;
+        }
+    }
+    return channel.rfind("book.", 0) == 0 && count(channel.begin(), channel.end(), '.') == 4;
+}
+
+void SubscriptionManager::sendBatched(const string &action, const vector<string> &channels,
+                                      vector<string> *confirmed)
+{
+    vector<string> publicChannels;
+    vector<string> privateChannels;
+    for (const auto &channel : channels)
+    {
+        (requiresPrivateScope(channel) ? privateChannels : publicChannels).push_back(channel);
+    }
+
+    // Batches sent before a failure stay in confirmed
+    auto sendGroup = [&](const string &scope, const vector<string> &group)
+    {
+        for (size_t offset = 0; offset < group.size(); offset += batchSize)
+        {
+            auto first = group.begin() + offset;
+            auto last = group.begin() + min(group.size(), offset + batchSize);
+            json response = sendRequest(scope + "/" + action, {{"channels", vector<string>(first, last)}});
+            if (confirmed && response.contains("result"))
+            {
+                for (const auto &channel : response["result"])
+                {
+                    confirmed->push_back(channel.get<string>());
+                }
+            }
+        }
+    };
+
+    sendGroup("public", publicChannels);
+    sendGroup("private", privateChannels);
+}
@@ -0,0 +1,129 @@
+#ifndef SUBSCRIPTION_MANAGER_HPP
+#define SUBSCRIPTION_MANAGER_HPP
+
+#include <nlohmann/json.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <map>
+#include <atomic>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+
+enum class ChannelInterval
+{
+    Raw,
+    Ms100,
+    Agg2
+};
+
+enum class DeliveryMode
+{
+    Immediate, // callback runs on the thread that decoded the notification
+    Conflated  // only the newest notification is kept until drainConflated(); snapshot channels only
+};
+
+using SubscriptionId = uint64_t;
+
+// Thrown by subscribe when a request fails part way. Channels the exchange
+// confirmed before the failure stay subscribed under id; unsubscribe(id)
+// drops them.
+class SubscriptionError : public runtime_error
+{
+public:
+    SubscriptionError(SubscriptionId id, const string &message) : runtime_error(message), id(id) {}
+
+    SubscriptionId id;
+};
+
+// Channels can have several subscribers. The exchange is asked to subscribe
+// a channel when its first subscriber arrives and to unsubscribe it when the
+// last one leaves.
+class SubscriptionManager
+{
+public:
+    using RequestSender = function<json(const string &method, const json &params)>;
+    using ChannelCallback = function<void(const json &)>;
+    using ChannelListCallback = function<void(const vector<string> &)>;
+
+    explicit SubscriptionManager(RequestSender sender, size_t maxChannelsPerRequest = 100);
+
+    static string intervalName(ChannelInterval interval);
+    static string bookChannel(const string &instrument, ChannelInterval interval);
+    static string bookSnapshotChannel(const string &instrument, int depth,
+                                      ChannelInterval interval, const string &group = "none");
+    static string tickerChannel(const string &instrument, ChannelInterval interval);
+    static string tradesChannel(const string &instrument, ChannelInterval interval);
+
+    // Adds a subscriber to every channel, sending as few requests as possible
+    // for the channels nobody had subscribed yet. The callback receives the
+    // notification params ({"channel", "data"}). Channels the exchange leaves
+    // out of its reply are not registered; channels(id) lists the ones that were.
+    SubscriptionId subscribe(const vector<string> &channels, ChannelCallback callback,
+                             DeliveryMode mode = DeliveryMode::Immediate);
+    // Other subscribers on the same channels keep receiving them
+    void unsubscribe(SubscriptionId id);
+    void unsubscribeAll();
+
+    // Sees every notification on a subscribed channel ahead of its callback
+    // or conflation. Set it before subscribing; it is not synchronised.
+    void setObserver(ChannelCallback callback);
+    // Told which channels restart (first subscriber, before the request is
+    // sent) or stop (last subscriber gone, after the request), so state built
+    // from their notifications can be dropped. Same rules as setObserver.
+    void setResetObserver(ChannelListCallback callback);
+
+    bool dispatch(json params);
+    size_t drainConflated();
+
+    vector<string> channels(SubscriptionId id) const;
+    // True once the exchange has confirmed the channel, while it has subscribers
+    bool isSubscribed(const string &channel) const;
+    vector<string> activeChannels() const;
+    uint64_t conflatedDropCount() const { return conflatedDrops.load(memory_order_relaxed); }
+
+private:
+    struct Subscriber
+    {
+        SubscriptionId id;
+        shared_ptr<const ChannelCallback> callback;
+        DeliveryMode mode;
+        json pending;
+        bool hasPending = false;
+    };
+
+    using CallbackList = vector<shared_ptr<const ChannelCallback>>;
+
+    struct ChannelState
+    {
+        vector<Subscriber> subscribers;
+        // Immediate subscribers' callbacks, rebuilt when subscribers change so
+        // dispatch only copies one pointer under the lock
+        shared_ptr<const CallbackList> immediate;
+        bool anyConflated = false;
+        bool live = false; // confirmed by the exchange
+    };
+
+    RequestSender sendRequest;
+    ChannelCallback observer;
+    ChannelListCallback resetObserver;
+    size_t batchSize;
+    mutable mutex stateMutex;
+    map<string, ChannelState> channelStates;
+    map<SubscriptionId, vector<string>> subscriptionChannels;
+    SubscriptionId nextSubscriptionId = 1;
+    atomic<uint64_t> conflatedDrops{0};
+
+    static bool requiresPrivateScope(const string &channel);
+    static bool isSnapshotChannel(const string &channel);
+    static void rebuild(ChannelState &state);
+    void settleSubscribe(SubscriptionId id, const vector<string> &requested, const vector<string> &confirmed);
+    void releaseChannels(const vector<string> &channels);
+    void sendBatched(const string &action, const vector<string> &channels, vector<string> *confirmed);
+};
+
+#endif
@@ -0,0 +1,678 @@
+#include "tick_store.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+namespace
+{
+    constexpr uint64_t kMagic = 0x31434954524544ULL; // "DERTIC1"
+    constexpr uint32_t kVersion = 2;
+    constexpr uint8_t kSnapshotFlag = 0x80;
+    constexpr int64_t kNanosecondsPerDay = 86400LL * 1000000000LL;
+    constexpr size_t kGrowthBlocks = 1024;
+
+    struct PartitionHeader
+    {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t reserved;
+        double priceScale;
+        double sizeScale;
+        uint64_t rowCount;
+        uint64_t blockCount;
+        int64_t lastTimestampNs;
+        int64_t lastPrice;
+        int64_t maxTimestampNs;
+        int64_t maxLatenessNs; // furthest any row fell behind maxTimestampNs
+    };
+
+    struct IndexEntry
+    {
+        int64_t firstTimestampNs;
+        int64_t firstPrice;
+        uint64_t firstRow;
+        int64_t minTimestampNs;
+        int64_t maxTimestampNs;
+        int64_t maxTimestampNsSoFar; // over this block and every earlier one
+    };
+
+    bool fitsInt32(int64_t value)
+    {
+        return value >= numeric_limits<int32_t>::min() && value <= numeric_limits<int32_t>::max();
+    }
+
+    int64_t dayOf(int64_t timestampNs)
+    {
+        return timestampNs >= 0 ? timestampNs / kNanosecondsPerDay
+                                : (timestampNs - kNanosecondsPerDay + 1) / kNanosecondsPerDay;
+    }
+
+    string dayDirectory(int64_t day)
+    {
+        // Civil date from days since the epoch (Howard Hinnant's algorithm)
+        day += 719468;
+        int64_t era = (day >= 0 ? day : day - 146096) / 146097;
+        unsigned dayOfEra = static_cast<unsigned>(day - era * 146097);
+        unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        int64_t year = static_cast<int64_t>(yearOfEra) + era * 400;
+        unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        unsigned monthPrime = (5 * dayOfYear + 2) / 153;
+        unsigned dayOfMonth = dayOfYear - (153 * monthPrime + 2) / 5 + 1;
+        unsigned month = monthPrime < 10 ? monthPrime + 3 : monthPrime - 9;
+        year += month <= 2;
+
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%04lld%02u%02u", static_cast<long long>(year), month, dayOfMonth);
+        return buffer;
+    }
+
+    uint64_t loadAcquire(const uint64_t &value)
+    {
+        return __atomic_load_n(&value, __ATOMIC_ACQUIRE);
+    }
+
+    void storeRelease(uint64_t &value, uint64_t newValue)
+    {
+        __atomic_store_n(&value, newValue, __ATOMIC_RELEASE);
+    }
+
+    class MappedColumn
+    {
+    public:
+        MappedColumn() = default;
+        MappedColumn(const MappedColumn &) = delete;
+        MappedColumn &operator=(const MappedColumn &) = delete;
+        ~MappedColumn() { unmap(); }
+
+        bool open(const string &path, bool writable)
+        {
+#ifdef _WIN32
+            throw runtime_error("TickStore requires POSIX mmap");
+#else
+            this->writable = writable;
+            fd = ::open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+            if (fd < 0)
+            {
+                if (!writable && errno == ENOENT)
+                {
+                    return false;
+                }
+                throw runtime_error("Cannot open " + path + ": " + strerror(errno));
+            }
+
+            struct stat info;
+            fstat(fd, &info);
+            map(static_cast<size_t>(info.st_size));
+            return true;
+#endif
+        }
+
+        void reserve(size_t minimumBytes)
+        {
+#ifndef _WIN32
+            if (minimumBytes <= bytes)
+            {
+                return;
+            }
+            if (ftruncate(fd, static_cast<off_t>(minimumBytes)) != 0)
+            {
+                throw runtime_error(string("Cannot grow tick column: ") + strerror(errno));
+            }
+            map(minimumBytes);
+#endif
+        }
+
+        void shrinkTo(size_t usedBytes)
+        {
+#ifndef _WIN32
+            if (fd >= 0 && writable && usedBytes < bytes)
+            {
+                map(0);
+                if (ftruncate(fd, static_cast<off_t>(usedBytes)) == 0)
+                {
+                    map(usedBytes);
+                }
+            }
+#endif
+        }
+
+        void sync()
+        {
+#ifndef _WIN32
+            if (data && writable)
+            {
+                msync(data, bytes, MS_ASYNC);
+            }
+#endif
+        }
+
+        void unmap()
+        {
+#ifndef _WIN32
+            map(0);
+            if (fd >= 0)
+            {
+                ::close(fd);
+                fd = -1;
+            }
+#endif
+        }
+
+        template <typename T>
+        T *as() const { return static_cast<T *>(data); }
+        size_t size() const { return bytes; }
+
+    private:
+        int fd = -1;
+        void *data = nullptr;
+        size_t bytes = 0;
+        bool writable = false;
+
+        void map(size_t newBytes)
+        {
+#ifndef _WIN32
+            if (data)
+            {
+                munmap(data, bytes);
+                data = nullptr;
+                bytes = 0;
+            }
+            if (newBytes == 0)
+            {
+                return;
+            }
+            int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+            void *mapped = mmap(nullptr, newBytes, protection, MAP_SHARED, fd, 0);
+            if (mapped == MAP_FAILED)
+            {
+                throw runtime_error(string("Cannot map tick column: ") + strerror(errno));
+            }
+            data = mapped;
+            bytes = newBytes;
+#endif
+        }
+    };
+}
+
+struct TickStore::Partition
+{
+    MappedColumn meta;
+    MappedColumn timestamps;
+    MappedColumn prices;
+    MappedColumn sizes;
+    MappedColumn types;
+    MappedColumn flags;
+    MappedColumn changeIds;
+    MappedColumn prevChangeIds;
+    MappedColumn index;
+    int64_t day = 0;
+    size_t rowsInBlock = 0;
+
+    PartitionHeader &header() const { return *meta.as<PartitionHeader>(); }
+
+    bool open(const string &directory, bool writable, double priceScale, double sizeScale)
+    {
+        if (writable)
+        {
+            filesystem::create_directories(directory);
+        }
+        if (!meta.open(directory + "/meta", writable))
+        {
+            return false;
+        }
+
+        if (meta.size() < sizeof(PartitionHeader))
+        {
+            if (!writable)
+            {
+                return false;
+            }
+            meta.reserve(sizeof(PartitionHeader));
+            header() = PartitionHeader{kMagic, kVersion, 0, priceScale, sizeScale, 0, 0, 0, 0, 0, 0};
+        }
+        if (header().magic != kMagic || header().version != kVersion)
+        {
+            throw runtime_error("Unrecognised tick partition in " + directory);
+        }
+
+        timestamps.open(directory + "/timestamps.col", writable);
+        prices.open(directory + "/prices.col", writable);
+        sizes.open(directory + "/sizes.col", writable);
+        types.open(directory + "/types.col", writable);
+        flags.open(directory + "/flags.col", writable);
+        changeIds.open(directory + "/change_ids.col", writable);
+        prevChangeIds.open(directory + "/prev_change_ids.col", writable);
+        index.open(directory + "/index.col", writable);
+
+        if (writable)
+        {
+            uint64_t rows = header().rowCount;
+            uint64_t blocks = header().blockCount;
+            reserveRows(rows + kGrowthRows);
+            reserveBlocks(blocks + kGrowthBlocks);
+            rowsInBlock = blocks > 0 ? rows - index.as<IndexEntry>()[blocks - 1].firstRow : 0;
+        }
+        return true;
+    }
+
+    void reserveRows(size_t rows)
+    {
+        timestamps.reserve(rows * sizeof(int32_t));
+        prices.reserve(rows * sizeof(int32_t));
+        sizes.reserve(rows * sizeof(int64_t));
+        types.reserve(rows * sizeof(TickType));
+        flags.reserve(rows * sizeof(uint8_t));
+        changeIds.reserve(rows * sizeof(int64_t));
+        prevChangeIds.reserve(rows * sizeof(int64_t));
+    }
+
+    // Columns are opened one after another while the writer may be growing
+    // them, so each can have a different length
+    uint64_t mappedRows() const
+    {
+        return min({timestamps.size() / sizeof(int32_t), prices.size() / sizeof(int32_t),
+                    sizes.size() / sizeof(int64_t), types.size() / sizeof(TickType),
+                    flags.size() / sizeof(uint8_t), changeIds.size() / sizeof(int64_t),
+                    prevChangeIds.size() / sizeof(int64_t)});
+    }
+
+    void reserveBlocks(size_t blocks)
+    {
+        index.reserve(blocks * sizeof(IndexEntry));
+    }
+
+    void append(const TickRecord &record)
+    {
+        auto &head = header();
+        uint64_t row = head.rowCount;
+        int64_t timestampDelta = record.timestampNs - head.lastTimestampNs;
+        int64_t priceDelta = record.price - head.lastPrice;
+
+        if ((row + 1) * sizeof(int64_t) > sizes.size())
+        {
+            reserveRows(row + kGrowthRows);
+        }
+
+        IndexEntry *entries = index.as<IndexEntry>();
+        if (row == 0 || rowsInBlock == kBlockRows || !fitsInt32(timestampDelta) || !fitsInt32(priceDelta))
+        {
+            uint64_t block = head.blockCount;
+            if ((block + 1) * sizeof(IndexEntry) > index.size())
+            {
+                reserveBlocks(block + kGrowthBlocks);
+                entries = index.as<IndexEntry>();
+            }
+            int64_t soFar = block > 0 ? max(entries[block - 1].maxTimestampNsSoFar, record.timestampNs)
+                                      : record.timestampNs;
+            entries[block] = IndexEntry{record.timestampNs, record.price, row,
+                                        record.timestampNs, record.timestampNs, soFar};
+            storeRelease(head.blockCount, block + 1);
+            timestampDelta = 0;
+            priceDelta = 0;
+            rowsInBlock = 0;
+        }
+
+        IndexEntry &entry = entries[head.blockCount - 1];
+        entry.minTimestampNs = min(entry.minTimestampNs, record.timestampNs);
+        entry.maxTimestampNs = max(entry.maxTimestampNs, record.timestampNs);
+        entry.maxTimestampNsSoFar = max(entry.maxTimestampNsSoFar, record.timestampNs);
+
+        timestamps.as<int32_t>()[row] = static_cast<int32_t>(timestampDelta);
+        prices.as<int32_t>()[row] = static_cast<int32_t>(priceDelta);
+        sizes.as<int64_t>()[row] = record.size;
+        types.as<TickType>()[row] = record.type;
+        flags.as<uint8_t>()[row] = static_cast<uint8_t>(record.action) | (record.snapshot ? kSnapshotFlag : 0);
+        changeIds.as<int64_t>()[row] = record.changeId;
+        prevChangeIds.as<int64_t>()[row] = record.prevChangeId;
+        rowsInBlock++;
+
+        if (row == 0)
+        {
+            head.maxTimestampNs = record.timestampNs;
+        }
+        else if (record.timestampNs < head.maxTimestampNs)
+        {
+            head.maxLatenessNs = max(head.maxLatenessNs, head.maxTimestampNs - record.timestampNs);
+        }
+        head.maxTimestampNs = max(head.maxTimestampNs, record.timestampNs);
+        head.lastTimestampNs = record.timestampNs;
+        head.lastPrice = record.price;
+        storeRelease(head.rowCount, row + 1);
+    }
+
+    void scan(int64_t fromNs, int64_t toNs, const function<void(const TickRecord &)> &visitor) const
+    {
+        // A reader in another process may have mapped less than the writer has since grown to
+        uint64_t rows = min<uint64_t>(loadAcquire(header().rowCount), mappedRows());
+        uint64_t blocks = min<uint64_t>(loadAcquire(header().blockCount), index.size() / sizeof(IndexEntry));
+        if (rows == 0 || blocks == 0)
+        {
+            return;
+        }
+        int64_t lateness = header().maxLatenessNs;
+
+        // maxTimestampNsSoFar never decreases, so blocks before the first one
+        // reaching fromNs hold nothing in range
+        const IndexEntry *entries = index.as<IndexEntry>();
+        const IndexEntry *firstReaching = partition_point(entries, entries + blocks,
+                                                          [fromNs](const IndexEntry &entry)
+                                                          { return entry.maxTimestampNsSoFar < fromNs; });
+
+        const int32_t *timestampDeltas = timestamps.as<int32_t>();
+        const int32_t *priceDeltas = prices.as<int32_t>();
+        const int64_t *sizeValues = sizes.as<int64_t>();
+        const TickType *typeValues = types.as<TickType>();
+        const uint8_t *flagValues = flags.as<uint8_t>();
+        const int64_t *changeIdValues = changeIds.as<int64_t>();
+        const int64_t *prevChangeIdValues = prevChangeIds.as<int64_t>();
+
+        for (size_t block = size_t(firstReaching - entries); block < blocks; ++block)
+        {
+            // No later row is more than lateness behind the newest timestamp before it
+            if (block > 0 && entries[block - 1].maxTimestampNsSoFar - lateness > toNs)
+            {
+                return;
+            }
+            const IndexEntry &entry = entries[block];
+            if (entry.minTimestampNs > toNs || entry.maxTimestampNs < fromNs)
+            {
+                continue;
+            }
+            uint64_t end = block + 1 < blocks ? entries[block + 1].firstRow : rows;
+            end = min(end, rows);
+
+            TickRecord record{entry.firstTimestampNs, entry.firstPrice, 0, TickType::BookBid};
+            for (uint64_t row = entry.firstRow; row < end; ++row)
+            {
+                record.timestampNs += timestampDeltas[row];
+                record.price += priceDeltas[row];
+                if (record.timestampNs >= fromNs && record.timestampNs <= toNs)
+                {
+                    record.size = sizeValues[row];
+                    record.type = typeValues[row];
+                    record.action = static_cast<BookAction>(flagValues[row] & ~kSnapshotFlag);
+                    record.snapshot = (flagValues[row] & kSnapshotFlag) != 0;
+                    record.changeId = changeIdValues[row];
+                    record.prevChangeId = prevChangeIdValues[row];
+                    visitor(record);
+                }
+            }
+        }
+    }
+
+    void flush()
+    {
+        for (auto *column : {&meta, &timestamps, &prices, &sizes, &types, &flags, &changeIds, &prevChangeIds, &index})
+        {
+            column->sync();
+        }
+    }
+
+    void close()
+    {
+        uint64_t rows = header().rowCount;
+        uint64_t blocks = header().blockCount;
+        timestamps.shrinkTo(rows * sizeof(int32_t));
+        prices.shrinkTo(rows * sizeof(int32_t));
+        sizes.shrinkTo(rows * sizeof(int64_t));
+        types.shrinkTo(rows * sizeof(TickType));
+        flags.shrinkTo(rows * sizeof(uint8_t));
+        changeIds.shrinkTo(rows * sizeof(int64_t));
+        prevChangeIds.shrinkTo(rows * sizeof(int64_t));
+        index.shrinkTo(blocks * sizeof(IndexEntry));
+        flush();
+    }
+};
+
+TickStore::TickStore(const string &rootDirectory, double priceScale, double sizeScale)
+    : root(rootDirectory), priceScale(priceScale), sizeScale(sizeScale)
+{
+#ifdef _WIN32
+    throw runtime_error("TickStore requires POSIX mmap");
+#endif
+    filesystem::create_directories(root);
+}
+
+TickStore::~TickStore()
+{
+    try
+    {
+        close();
+    }
+    catch (...)
+    {
+    }
+}
+
+string TickStore::partitionPath(const string &instrument, int64_t day) const
+{
+    return root + "/" + instrument + "/" + dayDirectory(day);
+}
+
+TickStore::Partition &TickStore::writerFor(const string &instrument, int64_t day)
+{
+    auto &partition = writers[instrument];
+    if (!partition || partition->day != day)
+    {
+        if (partition)
+        {
+            partition->close();
+        }
+        partition = make_unique<Partition>();
+        partition->day = day;
+        partition->open(partitionPath(instrument, day), true, priceScale, sizeScale);
+    }
+    return *partition;
+}
+
+void TickStore::append(const string &instrument, const TickRecord &record)
+{
+    writerFor(instrument, dayOf(record.timestampNs)).append(record);
+}
+
+void TickStore::append(const string &instrument, int64_t timestampNs, double price, double size, TickType type)
+{
+    append(instrument, TickRecord{timestampNs, llround(price * priceScale), llround(size * sizeScale), type});
+}
+
+void TickStore::flush()
+{
+    for (auto &[instrument, partition] : writers)
+    {
+        partition->flush();
+    }
+}
+
+void TickStore::close()
+{
+    for (auto &[instrument, partition] : writers)
+    {
+        partition->close();
+    }
+    writers.clear();
+}
+
+void TickStore::scan(const string &instrument, int64_t fromNs, int64_t toNs,
+                     const function<void(const TickRecord &)> &visitor) const
+{
+    for (int64_t day = dayOf(fromNs); day <= dayOf(toNs); ++day)
+    {
+        auto live = writers.find(instrument);
+        if (live != writers.end() && live->second->day == day)
+        {
+            live->second->scan(fromNs, toNs, visitor);
+            continue;
+        }
+
+        Partition partition;
+        if (partition.open(partitionPath(instrument, day), false, priceScale, sizeScale))
+        {
+            partition.scan(fromNs, toNs, visitor);
+        }
+    }
+}
+
+TickColumns TickStore::query(const string &instrument, int64_t fromNs, int64_t toNs) const
+{
+    TickColumns columns;
+    columns.priceScale = priceScale;
+    columns.sizeScale = sizeScale;
+    scan(instrument, fromNs, toNs, [&](const TickRecord &record)
+         {
+             columns.timestampsNs.push_back(record.timestampNs);
+             columns.prices.push_back(record.price);
+             columns.sizes.push_back(record.size);
+             columns.types.push_back(record.type);
+             columns.actions.push_back(record.action);
+             columns.snapshots.push_back(record.snapshot);
+             columns.changeIds.push_back(record.changeId);
+             columns.prevChangeIds.push_back(record.prevChangeId); });
+    return columns;
+}
+
+vector<string> TickStore::instruments() const
+{
+    vector<string> names;
+    for (const auto &entry : filesystem::directory_iterator(root))
+    {
+        if (entry.is_directory())
+        {
+            names.push_back(entry.path().filename().string());
+        }
+    }
+    sort(names.begin(), names.end());
+    return names;
+}
+
+void TickStore::captureNotification(const json &params)
+{
+    if (!params.contains("channel") || !params.contains("data"))
+    {
+        return;
+    }
+
+    const string &channel = params["channel"].get_ref<const string &>();
+    const json &data = params["data"];
+    if (channel.rfind("book.", 0) == 0)
+    {
+        captureBook(data.value("instrument_name", ""), data);
+    }
+    else if (channel.rfind("trades.", 0) == 0)
+    {
+        captureTrades(data);
+    }
+    else if (channel.rfind("ticker.", 0) == 0 || channel.rfind("quote.", 0) == 0)
+    {
+        captureQuote(data.value("instrument_name", ""), data);
+    }
+}
+
+void TickStore::captureBook(const string &instrument, const json &data)
+{
+    if (instrument.empty())
+    {
+        return;
+    }
+
+    // Grouped channels carry no type and are always full snapshots
+    TickRecord record{data.value("timestamp", int64_t(0)) * 1000000, 0, 0, TickType::BookBid};
+    record.snapshot = data.value("type", "snapshot") == "snapshot";
+    record.changeId = data.value("change_id", int64_t(0));
+    record.prevChangeId = record.snapshot ? 0 : data.value("prev_change_id", int64_t(0));
+
+    auto captureSide = [&](const char *key, TickType type)
+    {
+        if (!data.contains(key))
+        {
+            return;
+        }
+        record.type = type;
+        for (const auto &level : data[key])
+        {
+            // [action, price, amount] for incremental books, [price, amount] for grouped ones
+            double price;
+            double amount;
+            if (level.size() >= 3 && level[0].is_string())
+            {
+                const string &action = level[0].get_ref<const string &>();
+                record.action = action == "delete" ? BookAction::Delete
+                                : action == "change" ? BookAction::Change
+                                                     : BookAction::New;
+                price = level[1].get<double>();
+                amount = record.action == BookAction::Delete ? 0.0 : level[2].get<double>();
+            }
+            else if (level.size() >= 2)
+            {
+                record.action = BookAction::New;
+                price = level[0].get<double>();
+                amount = level[1].get<double>();
+            }
+            else
+            {
+                continue;
+            }
+            record.price = llround(price * priceScale);
+            record.size = llround(amount * sizeScale);
+            append(instrument, record);
+        }
+    };
+    captureSide("bids", TickType::BookBid);
+    captureSide("asks", TickType::BookAsk);
+}
+
+void TickStore::captureTrades(const json &data)
+{
+    for (const auto &trade : data)
+    {
+        string instrument = trade.value("instrument_name", "");
+        if (instrument.empty())
+        {
+            continue;
+        }
+        TickType type = trade.value("direction", "") == "buy" ? TickType::TradeBuy : TickType::TradeSell;
+        append(instrument, trade.value("timestamp", int64_t(0)) * 1000000,
+               trade.value("price", 0.0), trade.value("amount", 0.0), type);
+    }
+}
+
+void TickStore::captureQuote(const string &instrument, const json &data)
+{
+    if (instrument.empty())
+    {
+        return;
+    }
+
+    auto number = [&](const char *key)
+    {
+        auto it = data.find(key);
+        return it != data.end() && it->is_number() ? it->get<double>() : 0.0;
+    };
+
+    int64_t timestampNs = data.value("timestamp", int64_t(0)) * 1000000;
+    BestQuote quote{number("best_bid_price"), number("best_bid_amount"),
+                    number("best_ask_price"), number("best_ask_amount")};
+    auto &last = lastQuotes[instrument];
+
+    // Only changes to the best bid or offer are stored
+    if (quote.bidPrice != last.bidPrice || quote.bidSize != last.bidSize)
+    {
+        append(instrument, timestampNs, quote.bidPrice, quote.bidSize, TickType::BestBid);
+    }
+    if (quote.askPrice != last.askPrice || quote.askSize != last.askSize)
+    {
+        append(instrument, timestampNs, quote.askPrice, quote.askSize, TickType::BestAsk);
+    }
+    last = quote;
+}
@@ -0,0 +1,122 @@
+#ifndef TICK_STORE_HPP
+#define TICK_STORE_HPP
+
+#include <nlohmann/json.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+enum class TickType : uint8_t
+{
+    BookBid,
+    BookAsk,
+    TradeBuy,
+    TradeSell,
+    BestBid,
+    BestAsk
+};
+
+// Level action of a book row; None for trades and best bid/offer rows
+enum class BookAction : uint8_t
+{
+    None,
+    New,
+    Change,
+    Delete
+};
+
+struct TickRecord
+{
+    int64_t timestampNs; // exchange time, stored as received even when it goes backwards
+    int64_t price;       // price * priceScale
+    int64_t size;        // size * sizeScale, 0 for a deleted book level
+    TickType type;
+    BookAction action = BookAction::None;
+    bool snapshot = false;    // book row that belongs to a full snapshot
+    int64_t changeId = 0;     // book change_id, 0 for other rows
+    int64_t prevChangeId = 0; // book prev_change_id, 0 for snapshots and other rows
+};
+
+struct TickColumns
+{
+    vector<int64_t> timestampsNs;
+    vector<int64_t> prices;
+    vector<int64_t> sizes;
+    vector<TickType> types;
+    vector<BookAction> actions;
+    vector<bool> snapshots;
+    vector<int64_t> changeIds;
+    vector<int64_t> prevChangeIds;
+    double priceScale = 1.0;
+    double sizeScale = 1.0;
+
+    size_t size() const { return timestampsNs.size(); }
+    double price(size_t i) const { return double(prices[i]) / priceScale; }
+    double amount(size_t i) const { return double(sizes[i]) / sizeScale; }
+};
+
+// Append-only market data store with one directory per instrument and UTC
+// day. Each day holds memory-mapped columns: timestamps and prices as signed
+// int32 deltas, sizes, change_id and prev_change_id as int64, and the tick
+// type and book flags as bytes, plus an index of blocks whose first row is
+// stored absolute. Appends are plain stores into the mappings; files only
+// grow (and remap) every kGrowthRows rows. Timestamps are not required to
+// be ordered: each block records its range and the partition how far any
+// row fell behind the newest one, which bounds range scans.
+class TickStore
+{
+public:
+    explicit TickStore(const string &rootDirectory, double priceScale = 1e4, double sizeScale = 1e4);
+    ~TickStore();
+
+    TickStore(const TickStore &) = delete;
+    TickStore &operator=(const TickStore &) = delete;
+
+    void append(const string &instrument, const TickRecord &record);
+    void append(const string &instrument, int64_t timestampNs, double price, double size, TickType type);
+
+    // Decodes a book / trades / ticker / quote subscription notification ({"channel", "data"})
+    void captureNotification(const json &params);
+
+    void flush();
+    void close();
+
+    void scan(const string &instrument, int64_t fromNs, int64_t toNs,
+              const function<void(const TickRecord &)> &visitor) const;
+    TickColumns query(const string &instrument, int64_t fromNs, int64_t toNs) const;
+    vector<string> instruments() const;
+
+    static constexpr size_t kBlockRows = 4096;
+    static constexpr size_t kGrowthRows = size_t(1) << 20;
+
+private:
+    struct Partition;
+
+    string root;
+    double priceScale;
+    double sizeScale;
+    unordered_map<string, unique_ptr<Partition>> writers;
+
+    struct BestQuote
+    {
+        double bidPrice = 0.0;
+        double bidSize = 0.0;
+        double askPrice = 0.0;
+        double askSize = 0.0;
+    };
+    unordered_map<string, BestQuote> lastQuotes;
+
+    Partition &writerFor(const string &instrument, int64_t day);
+    string partitionPath(const string &instrument, int64_t day) const;
+    void captureBook(const string &instrument, const json &data);
+    void captureTrades(const json &data);
+    void captureQuote(const string &instrument, const json &data);
+};
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef TIMESTAMPING_SOCKET_HPP
+#define TIMESTAMPING_SOCKET_HPP
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/detail/throw_error.hpp>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <cerrno>
+#endif
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#endif
+
+using namespace std;
+
+// Thrown instead of returning an error code so the SSL and websocket layers
+// above are left usable; the read can simply be retried.
+struct SocketReadTimeout : runtime_error
+{
+    SocketReadTimeout() : runtime_error("Socket read deadline passed") {}
+};
+
+// TCP socket that, once enabled, reads through recvmsg() so the kernel's
+// software receive timestamp of each segment can be collected. The SSL layer
+// only ever calls read_some, so the ordinary socket handles everything else.
+class TimestampingSocket : public boost::asio::ip::tcp::socket
+{
+public:
+    explicit TimestampingSocket(boost::asio::io_context &context)
+        : boost::asio::ip::tcp::socket(context) {}
+
+    bool enableKernelTimestamps()
+    {
+#ifdef __linux__
+        int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        kernelTimestamps = ::setsockopt(native_handle(), SOL_SOCKET, SO_TIMESTAMPING,
+                                        &flags, sizeof(flags)) == 0;
+#endif
+        return kernelTimestamps;
+    }
+
+    bool kernelTimestampsEnabled() const { return kernelTimestamps; }
+
+    // CLOCK_REALTIME nanoseconds of the newest segment read, or 0 if unknown
+    int64_t lastKernelReceiveNanoseconds() const { return lastKernelReceiveNs; }
+
+    // A read that would still be waiting for data at the deadline throws
+    // SocketReadTimeout. A default time_point waits indefinitely.
+    void setReadDeadline(chrono::steady_clock::time_point deadline) { readDeadline = deadline; }
+
+    template <typename MutableBufferSequence>
+    size_t read_some(const MutableBufferSequence &buffers, boost::system::error_code &ec)
+    {
+#ifdef __linux__
+        if (kernelTimestamps)
+        {
+            return readWithTimestamp(buffers, ec);
+        }
+#endif
+        if (readDeadline != chrono::steady_clock::time_point{})
+        {
+            waitReadable();
+        }
+        return boost::asio::ip::tcp::socket::read_some(buffers, ec);
+    }
+
+    template <typename MutableBufferSequence>
+    size_t read_some(const MutableBufferSequence &buffers)
+    {
+        boost::system::error_code ec;
+        size_t bytes = read_some(buffers, ec);
+        boost::asio::detail::throw_error(ec, "read_some");
+        return bytes;
+    }
+
+private:
+    bool kernelTimestamps = false;
+    int64_t lastKernelReceiveNs = 0;
+    chrono::steady_clock::time_point readDeadline{};
+
+    // Returns once the socket is readable or in error; the read that follows reports which
+    void waitReadable()
+    {
+        for (;;)
+        {
+            int timeoutMs = -1;
+            if (readDeadline != chrono::steady_clock::time_point{})
+            {
+                auto remaining = chrono::ceil<chrono::milliseconds>(readDeadline - chrono::steady_clock::now());
+                if (remaining.count() <= 0)
+                {
+                    throw SocketReadTimeout();
+                }
+                timeoutMs = static_cast<int>(min<int64_t>(remaining.count(), INT_MAX));
+            }
+#ifdef _WIN32
+            WSAPOLLFD readable{native_handle(), POLLRDNORM, 0};
+            int ready = ::WSAPoll(&readable, 1, timeoutMs);
+#else
+            pollfd readable{native_handle(), POLLIN, 0};
+            int ready = ::poll(&readable, 1, timeoutMs);
+            if (ready < 0 && errno == EINTR)
+            {
+                continue;
+            }
+#endif
+            if (ready != 0)
+            {
+                return;
+            }
+        }
+    }
+
+#ifdef __linux__
+    template <typename MutableBufferSequence>
+    size_t readWithTimestamp(const MutableBufferSequence &buffers, boost::system::error_code &ec)
+    {
+        constexpr size_t maxSegments = 16;
+        iovec segments[maxSegments];
+        size_t segmentCount = 0;
+        for (auto it = boost::asio::buffer_sequence_begin(buffers);
+             it != boost::asio::buffer_sequence_end(buffers) && segmentCount < maxSegments; ++it)
+        {
+            boost::asio::mutable_buffer buffer(*it);
+            if (buffer.size() > 0)
+            {
+                segments[segmentCount].iov_base = buffer.data();
+                segments[segmentCount].iov_len = buffer.size();
+                ++segmentCount;
+            }
+        }
+        if (segmentCount == 0)
+        {
+            ec = {};
+            return 0;
+        }
+
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(timespec))];
+        for (;;)
+        {
+            msghdr message{};
+            message.msg_iov = segments;
+            message.msg_iovlen = segmentCount;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+
+            // The socket is blocking; with a deadline the wait happens in poll() instead
+            int flags = readDeadline != chrono::steady_clock::time_point{} ? MSG_DONTWAIT : 0;
+            ssize_t received = ::recvmsg(native_handle(), &message, flags);
+            if (received > 0)
+            {
+                for (cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+                {
+                    if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SO_TIMESTAMPING)
+                    {
+                        const auto *stamps = reinterpret_cast<const scm_timestamping *>(CMSG_DATA(header));
+                        lastKernelReceiveNs = int64_t(stamps->ts[0].tv_sec) * 1000000000LL + stamps->ts[0].tv_nsec;
+                    }
+                }
+                ec = {};
+                return static_cast<size_t>(received);
+            }
+            if (received == 0)
+            {
+                ec = boost::asio::error::eof;
+                return 0;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                waitReadable();
+                continue;
+            }
+            ec = boost::system::error_code(errno, boost::asio::error::get_system_category());
+            return 0;
+        }
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,311 @@
+#include "trade_tracer.hpp"
+#include <iostream>
+#include <iomanip>
+using namespace std;
+
+thread_local TraceContext TradeTracer::current;
+atomic<uint64_t> TradeTracer::nextTraceId{1};
+
+mutex TradeTracer::statsMutex;
+array<LatencyHistogram, kTraceStageCount> TradeTracer::stageHistograms;
+LatencyHistogram TradeTracer::tickToTradeHistogram;
+LatencyHistogram TradeTracer::tickToAckHistogram;
+deque<TraceContext> TradeTracer::sampledTraces;
+deque<TraceContext> TradeTracer::outlierTraces;
+uint32_t TradeTracer::sampleEvery = 64;
+uint64_t TradeTracer::outlierThresholdNs = 1000000;
+uint64_t TradeTracer::completedCount = 0;
+
+namespace
+{
+    constexpr size_t kMaxRetainedTraces = 256;
+
+    int highestBit(uint64_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(value);
+#else
+        int bit = 0;
+        while (value >>= 1)
+        {
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+}
+
+size_t LatencyHistogram::bucketFor(uint64_t value)
+{
+    if (value < kSubBuckets)
+    {
+        return static_cast<size_t>(value);
+    }
+    int shift = highestBit(value) - 4;
+    return static_cast<size_t>(shift + 1) * kSubBuckets + ((value >> shift) & (kSubBuckets - 1));
+}
+
+uint64_t LatencyHistogram::bucketLowerBound(size_t index)
+{
+    if (index < kSubBuckets)
+    {
+        return index;
+    }
+    size_t shift = index / kSubBuckets - 1;
+    return (kSubBuckets + index % kSubBuckets) << shift;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+    buckets[bucketFor(nanoseconds)]++;
+    total++;
+    minValue = min(minValue, nanoseconds);
+    maxValue = max(maxValue, nanoseconds);
+}
+
+void LatencyHistogram::clear()
+{
+    buckets.fill(0);
+    total = 0;
+    minValue = ~uint64_t(0);
+    maxValue = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(fraction * double(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            return min(max(bucketLowerBound(i), minimum()), maxValue);
+        }
+    }
+    return maxValue;
+}
+
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
+void TradeTracer::beginFrame(TscClock::ticks readTicks, int64_t kernelReceiveNs)
+{
+    current = TraceContext{};
+    current.traceId = nextTraceId.fetch_add(1, memory_order_relaxed);
+    current.kernelReceiveNs = kernelReceiveNs;
+    current.stamps[static_cast<size_t>(TraceStage::SocketRead)] = readTicks;
+}
+
+void TradeTracer::stamp(TraceContext &context, TraceStage stage)
+{
+    if (context.active())
+    {
+        context.stamps[static_cast<size_t>(stage)] = TscClock::now();
+    }
+}
+
+TraceContext TradeTracer::takeCurrent()
+{
+    TraceContext taken = current;
+    current = TraceContext{};
+    return taken;
+}
+
+void TradeTracer::resume(const TraceContext &context)
+{
+    if (!context.active())
+    {
+        current = TraceContext{};
+        return;
+    }
+
+    current = context;
+    for (size_t stage = static_cast<size_t>(TraceStage::Decision); stage < kTraceStageCount; ++stage)
+    {
+        current.stamps[stage] = 0;
+    }
+    if (context.has(TraceStage::Decision))
+    {
+        current.traceId = nextTraceId.fetch_add(1, memory_order_relaxed);
+    }
+}
+
+void TradeTracer::complete(const TraceContext &context)
+{
+    if (!context.active() || !context.has(TraceStage::Decision))
+    {
+        return;
+    }
+
+    lock_guard<mutex> lock(statsMutex);
+
+    TscClock::ticks previous = 0;
+    for (size_t stage = 0; stage < kTraceStageCount; ++stage)
+    {
+        TscClock::ticks stamp = context.stamps[stage];
+        if (stamp == 0)
+        {
+            continue;
+        }
+        if (previous != 0)
+        {
+            stageHistograms[stage].record(static_cast<uint64_t>(TscClock::toNanoseconds(stamp - previous)));
+        }
+        else if (context.kernelReceiveNs != 0)
+        {
+            int64_t kernelToRead = TscClock::toRealtimeNanoseconds(stamp) - context.kernelReceiveNs;
+            if (kernelToRead >= 0)
+            {
+                stageHistograms[stage].record(static_cast<uint64_t>(kernelToRead));
+            }
+        }
+        previous = stamp;
+    }
+
+    TscClock::ticks origin = context.at(TraceStage::SocketRead);
+    uint64_t tickToTrade = 0;
+    if (context.has(TraceStage::WireWrite))
+    {
+        tickToTrade = static_cast<uint64_t>(TscClock::toNanoseconds(context.at(TraceStage::WireWrite) - origin));
+        tickToTradeHistogram.record(tickToTrade);
+    }
+    if (context.has(TraceStage::ExchangeAck))
+    {
+        tickToAckHistogram.record(static_cast<uint64_t>(TscClock::toNanoseconds(context.at(TraceStage::ExchangeAck) - origin)));
+    }
+
+    completedCount++;
+    if (sampleEvery > 0 && completedCount % sampleEvery == 0)
+    {
+        sampledTraces.push_back(context);
+        if (sampledTraces.size() > kMaxRetainedTraces)
+        {
+            sampledTraces.pop_front();
+        }
+    }
+    if (tickToTrade >= outlierThresholdNs)
+    {
+        outlierTraces.push_back(context);
+        if (outlierTraces.size() > kMaxRetainedTraces)
+        {
+            outlierTraces.pop_front();
+        }
+    }
+}
+#endif
+
+void TradeTracer::setSampling(uint32_t everyNth, double outlierMicroseconds)
+{
+    lock_guard<mutex> lock(statsMutex);
+    sampleEvery = everyNth;
+    outlierThresholdNs = static_cast<uint64_t>(outlierMicroseconds * 1000.0);
+}
+
+void TradeTracer::displayTraceStats()
+{
+    TscClock::recalibrateIfDue();
+
+    lock_guard<mutex> lock(statsMutex);
+    cout << "\n=== Tick-to-Trade Statistics ===\n";
+    cout << "Completed traces: " << completedCount << "\n";
+    for (size_t stage = 0; stage < kTraceStageCount; ++stage)
+    {
+        printHistogram(stageName(static_cast<TraceStage>(stage)), stageHistograms[stage]);
+    }
+    printHistogram("Tick to Trade (read -> wire)", tickToTradeHistogram);
+    printHistogram("Tick to Ack (read -> ack)", tickToAckHistogram);
+}
+
+void TradeTracer::dumpSampledTraces(ostream &out)
+{
+    lock_guard<mutex> lock(statsMutex);
+    out << "=== Sampled Traces (" << sampledTraces.size() << ") ===\n";
+    for (const auto &context : sampledTraces)
+    {
+        dumpTrace(out, context);
+    }
+    out << "=== Outlier Traces (>= " << outlierThresholdNs / 1000.0 << " us, "
+        << outlierTraces.size() << ") ===\n";
+    for (const auto &context : outlierTraces)
+    {
+        dumpTrace(out, context);
+    }
+}
+
+void TradeTracer::resetStatistics()
+{
+    lock_guard<mutex> lock(statsMutex);
+    for (auto &histogram : stageHistograms)
+    {
+        histogram.clear();
+    }
+    tickToTradeHistogram.clear();
+    tickToAckHistogram.clear();
+    sampledTraces.clear();
+    outlierTraces.clear();
+    completedCount = 0;
+}
+
+const char *TradeTracer::stageName(TraceStage stage)
+{
+    switch (stage)
+    {
+    case TraceStage::SocketRead:
+        return "Socket Read";
+    case TraceStage::Parse:
+        return "Parse";
+    case TraceStage::Dispatch:
+        return "Dispatch";
+    case TraceStage::Decision:
+        return "Order Decision";
+    case TraceStage::Encode:
+        return "Encode";
+    case TraceStage::WireWrite:
+        return "Wire Write";
+    case TraceStage::ExchangeAck:
+        return "Exchange Ack";
+    default:
+        return "Unknown";
+    }
+}
+
+void TradeTracer::printHistogram(const string &label, const LatencyHistogram &histogram)
+{
+    if (histogram.count() == 0)
+    {
+        return;
+    }
+    cout << "\n"
+         << label << " (us):\n"
+         << fixed << setprecision(2)
+         << "  p50: " << histogram.percentile(0.50) / 1000.0
+         << "  p90: " << histogram.percentile(0.90) / 1000.0
+         << "  p99: " << histogram.percentile(0.99) / 1000.0
+         << "  p99.9: " << histogram.percentile(0.999) / 1000.0 << "\n"
+         << "  Min: " << histogram.minimum() / 1000.0
+         << "  Max: " << histogram.maximum() / 1000.0
+         << "  Sample Count: " << histogram.count() << "\n";
+}
+
+void TradeTracer::dumpTrace(ostream &out, const TraceContext &context)
+{
+    TscClock::ticks origin = context.at(TraceStage::SocketRead);
+    out << "trace " << context.traceId;
+    if (context.kernelReceiveNs != 0)
+    {
+        out << " kernel_rx_ns=" << context.kernelReceiveNs;
+    }
+    for (size_t stage = 0; stage < kTraceStageCount; ++stage)
+    {
+        if (context.stamps[stage] != 0)
+        {
+            out << " " << stageName(static_cast<TraceStage>(stage)) << "=+"
+                << fixed << setprecision(0) << TscClock::toNanoseconds(context.stamps[stage] - origin) << "ns";
+        }
+    }
+    out << "\n";
+}
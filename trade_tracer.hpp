@@ -0,0 +1,134 @@
+#ifndef TRADE_TRACER_HPP
+#define TRADE_TRACER_HPP
+
+#include "tsc_clock.hpp"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+using namespace std;
+
+enum class TraceStage : uint8_t
+{
+    SocketRead,
+    Parse,
+    Dispatch,
+    Decision,
+    Encode,
+    WireWrite,
+    ExchangeAck,
+    Count
+};
+
+constexpr size_t kTraceStageCount = static_cast<size_t>(TraceStage::Count);
+
+struct TraceContext
+{
+    uint64_t traceId = 0;
+    int64_t kernelReceiveNs = 0;
+    array<TscClock::ticks, kTraceStageCount> stamps{};
+
+    bool active() const { return traceId != 0; }
+    bool has(TraceStage stage) const { return stamps[static_cast<size_t>(stage)] != 0; }
+    TscClock::ticks at(TraceStage stage) const { return stamps[static_cast<size_t>(stage)]; }
+};
+
+// Log-linear histogram of nanosecond values: 16 sub-buckets per power of two,
+// so every recorded value is within ~6% of its bucket's lower bound.
+class LatencyHistogram
+{
+public:
+    void record(uint64_t nanoseconds);
+    void clear();
+
+    uint64_t count() const { return total; }
+    uint64_t minimum() const { return total ? minValue : 0; }
+    uint64_t maximum() const { return maxValue; }
+    uint64_t percentile(double fraction) const;
+
+private:
+    static constexpr size_t kSubBuckets = 16;
+    static constexpr size_t kBuckets = 61 * kSubBuckets;
+
+    array<uint64_t, kBuckets> buckets{};
+    uint64_t total = 0;
+    uint64_t minValue = ~uint64_t(0);
+    uint64_t maxValue = 0;
+
+    static size_t bucketFor(uint64_t value);
+    static uint64_t bucketLowerBound(size_t index);
+};
+
+// Follows one received frame through decode, the market data handler and the
+// order it triggers. The trace for the frame being handled lives in a
+// thread-local slot, so each stage is a single counter read and store.
+class TradeTracer
+{
+public:
+#ifndef DERIBIT_DISABLE_INSTRUMENTATION
+    static void beginFrame(TscClock::ticks readTicks, int64_t kernelReceiveNs = 0);
+    // Called once the frame has been handled, so later work on the thread
+    // (timers, user input) is not attributed to it
+    static void endFrame() { current = TraceContext{}; }
+    static void stamp(TraceStage stage)
+    {
+        // A decision only counts as tick-to-trade while a frame is being dispatched
+        if (stage == TraceStage::Decision && !current.has(TraceStage::Dispatch))
+        {
+            return;
+        }
+        if (current.active() && current.stamps[static_cast<size_t>(stage)] == 0)
+        {
+            current.stamps[static_cast<size_t>(stage)] = TscClock::now();
+        }
+    }
+    static void stamp(TraceContext &context, TraceStage stage);
+
+    // Hands the current trace to a caller that will wait for the exchange
+    // reply; resume() reinstates the frame so later orders from the same
+    // handler are traced from the same arrival.
+    static TraceContext takeCurrent();
+    static void resume(const TraceContext &context);
+    static void complete(const TraceContext &context);
+#else
+    // Compiled out with the other probes; no frame is ever traced
+    static void beginFrame(TscClock::ticks, int64_t = 0) {}
+    static void endFrame() {}
+    static void stamp(TraceStage) {}
+    static void stamp(TraceContext &, TraceStage) {}
+    static TraceContext takeCurrent() { return TraceContext{}; }
+    static void resume(const TraceContext &) {}
+    static void complete(const TraceContext &) {}
+#endif
+
+    static void setSampling(uint32_t everyNth, double outlierMicroseconds);
+    static void displayTraceStats();
+    static void dumpSampledTraces(ostream &out);
+    static void resetStatistics();
+
+    static const char *stageName(TraceStage stage);
+
+private:
+    static thread_local TraceContext current;
+    static atomic<uint64_t> nextTraceId;
+
+    static mutex statsMutex;
+    // Entry i is the time from the previous stamped stage to stage i; for
+    // SocketRead it is the kernel receive timestamp, when one is known.
+    static array<LatencyHistogram, kTraceStageCount> stageHistograms;
+    static LatencyHistogram tickToTradeHistogram;
+    static LatencyHistogram tickToAckHistogram;
+    static deque<TraceContext> sampledTraces;
+    static deque<TraceContext> outlierTraces;
+    static uint32_t sampleEvery;
+    static uint64_t outlierThresholdNs;
+    static uint64_t completedCount;
+
+    static void printHistogram(const string &label, const LatencyHistogram &histogram);
+    static void dumpTrace(ostream &out, const TraceContext &context);
+};
+
+#endif
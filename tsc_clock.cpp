@@ -0,0 +1,194 @@
+#include "tsc_clock.hpp"
+#include <algorithm>
+#include <limits>
+#if defined(DERIBIT_HAS_TSC) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+using namespace std;
+
+namespace
+{
+    int64_t monotonicNanoseconds()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(
+                   chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    int64_t realtimeNanoseconds()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(
+                   chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // Brackets a clock read between two counter reads and keeps the tightest
+    // of a few attempts, so the pair is not skewed by an interrupt.
+    // False if the counter ran backwards in every attempt (the reads landed on
+    // cores whose counters disagree); the outputs are zeroed then
+    bool samplePair(uint64_t &tsc, int64_t &monotonicNs)
+    {
+        tsc = 0;
+        monotonicNs = 0;
+        bool sampled = false;
+        uint64_t bestSpread = numeric_limits<uint64_t>::max();
+        for (int attempt = 0; attempt < 5; ++attempt)
+        {
+            uint64_t before = TscClock::now();
+            int64_t clockNs = monotonicNanoseconds();
+            uint64_t after = TscClock::nowOrdered();
+            if (int64_t(after - before) < 0)
+            {
+                continue;
+            }
+            if (after - before < bestSpread)
+            {
+                bestSpread = after - before;
+                tsc = before + (after - before) / 2;
+                monotonicNs = clockNs;
+                sampled = true;
+            }
+        }
+        return sampled;
+    }
+}
+
+bool TscClock::tscEnabled = TscClock::detectInvariantTsc();
+atomic<double> TscClock::nanosecondsPerTick{1.0};
+atomic<int64_t> TscClock::recalibrationIntervalNs{60'000'000'000LL};
+atomic<int64_t> TscClock::nextRecalibrationNs{0};
+mutex TscClock::calibrationMutex;
+TscClock::Calibration TscClock::calibration;
+
+static const bool calibratedAtStartup = (TscClock::calibrate(), true);
+
+bool TscClock::detectInvariantTsc()
+{
+#ifdef DERIBIT_HAS_TSC
+    unsigned int regs[4] = {0, 0, 0, 0};
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if (static_cast<unsigned int>(info[0]) < 0x80000007)
+    {
+        return false;
+    }
+    __cpuid(info, 0x80000007);
+    regs[3] = static_cast<unsigned int>(info[3]);
+#else
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007 ||
+        !__get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]))
+    {
+        return false;
+    }
+#endif
+    return (regs[3] & (1u << 8)) != 0;
+#else
+    return false;
+#endif
+}
+
+void TscClock::calibrate(chrono::microseconds window)
+{
+    Calibration fresh;
+    bool sampled = samplePair(fresh.baseTicks, fresh.baseMonotonicNs);
+    if (!sampled)
+    {
+        fresh.baseTicks = now();
+        fresh.baseMonotonicNs = monotonicNanoseconds();
+    }
+    fresh.baseRealtimeNs = realtimeNanoseconds() - (monotonicNanoseconds() - fresh.baseMonotonicNs);
+
+    double rate = 1.0;
+    if (tscEnabled && sampled)
+    {
+        int64_t deadline = fresh.baseMonotonicNs +
+                           chrono::duration_cast<chrono::nanoseconds>(window).count();
+        while (monotonicNanoseconds() < deadline)
+        {
+        }
+        if (samplePair(fresh.lastTicks, fresh.lastMonotonicNs) && fresh.lastTicks > fresh.baseTicks)
+        {
+            rate = double(fresh.lastMonotonicNs - fresh.baseMonotonicNs) /
+                   double(fresh.lastTicks - fresh.baseTicks);
+        }
+        else
+        {
+            rate = nanosecondsPerTick.load(memory_order_relaxed);
+            fresh.lastTicks = fresh.baseTicks;
+            fresh.lastMonotonicNs = fresh.baseMonotonicNs;
+        }
+    }
+    else
+    {
+        fresh.lastTicks = fresh.baseTicks;
+        fresh.lastMonotonicNs = fresh.baseMonotonicNs;
+    }
+
+    lock_guard<mutex> lock(calibrationMutex);
+    calibration = fresh;
+    nanosecondsPerTick.store(rate, memory_order_relaxed);
+    nextRecalibrationNs.store(fresh.lastMonotonicNs + recalibrationIntervalNs.load(memory_order_relaxed),
+                              memory_order_relaxed);
+}
+
+void TscClock::recalibrateIfDue()
+{
+    int64_t nowNs = monotonicNanoseconds();
+    if (!tscEnabled || nowNs < nextRecalibrationNs.load(memory_order_relaxed))
+    {
+        return;
+    }
+
+    // The rate is refit over the whole span since startup, which averages
+    // out read jitter far better than another short busy-wait would.
+    ticks sampleTicks = 0;
+    int64_t sampleNs = 0;
+    if (!samplePair(sampleTicks, sampleNs))
+    {
+        return;
+    }
+
+    lock_guard<mutex> lock(calibrationMutex);
+    if (sampleTicks > calibration.baseTicks && sampleNs > calibration.baseMonotonicNs)
+    {
+        nanosecondsPerTick.store(double(sampleNs - calibration.baseMonotonicNs) /
+                                     double(sampleTicks - calibration.baseTicks),
+                                 memory_order_relaxed);
+    }
+    calibration.lastTicks = sampleTicks;
+    calibration.lastMonotonicNs = sampleNs;
+    nextRecalibrationNs.store(sampleNs + recalibrationIntervalNs.load(memory_order_relaxed),
+                              memory_order_relaxed);
+}
+
+void TscClock::setRecalibrationInterval(chrono::seconds interval)
+{
+    recalibrationIntervalNs.store(chrono::duration_cast<chrono::nanoseconds>(interval).count(),
+                                  memory_order_relaxed);
+}
+
+double TscClock::toNanoseconds(ticks elapsed)
+{
+    return double(elapsed) * nanosecondsPerTick.load(memory_order_relaxed);
+}
+
+int64_t TscClock::toMonotonicNanoseconds(ticks stamp)
+{
+    lock_guard<mutex> lock(calibrationMutex);
+    double offset = double(int64_t(stamp - calibration.baseTicks)) *
+                    nanosecondsPerTick.load(memory_order_relaxed);
+    return calibration.baseMonotonicNs + static_cast<int64_t>(offset);
+}
+
+int64_t TscClock::toRealtimeNanoseconds(ticks stamp)
+{
+    int64_t monotonicNs = toMonotonicNanoseconds(stamp);
+    lock_guard<mutex> lock(calibrationMutex);
+    return calibration.baseRealtimeNs + (monotonicNs - calibration.baseMonotonicNs);
+}
+
+double TscClock::ticksPerNanosecond()
+{
+    return 1.0 / nanosecondsPerTick.load(memory_order_relaxed);
+}
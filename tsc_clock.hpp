@@ -0,0 +1,96 @@
+#ifndef TSC_CLOCK_HPP
+#define TSC_CLOCK_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define DERIBIT_HAS_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+using namespace std;
+
+// Cycle-counter clock for instrumentation. Hot paths store raw ticks from
+// now(); conversion to nanoseconds happens at reporting time against the
+// CLOCK_MONOTONIC calibration. Without an invariant TSC the clock falls back
+// to steady_clock nanoseconds, so one tick is one nanosecond.
+class TscClock
+{
+public:
+    using ticks = uint64_t;
+
+    static ticks now()
+    {
+#ifdef DERIBIT_HAS_TSC
+        if (tscEnabled)
+        {
+            _mm_lfence();
+            ticks value = __rdtsc();
+            _mm_lfence();
+            return value;
+        }
+#endif
+        return steadyNanoseconds();
+    }
+
+    // Waits for all earlier instructions to retire; use to close a measured region
+    static ticks nowOrdered()
+    {
+#ifdef DERIBIT_HAS_TSC
+        if (tscEnabled)
+        {
+            unsigned int aux;
+            ticks value = __rdtscp(&aux);
+            _mm_lfence();
+            return value;
+        }
+#endif
+        return steadyNanoseconds();
+    }
+
+    static void calibrate(chrono::microseconds window = chrono::microseconds(10000));
+    static void recalibrateIfDue();
+    static void setRecalibrationInterval(chrono::seconds interval);
+
+    static double toNanoseconds(ticks elapsed);
+    static double toMilliseconds(ticks elapsed) { return toNanoseconds(elapsed) / 1e6; }
+    static int64_t toMonotonicNanoseconds(ticks stamp);
+    static int64_t toRealtimeNanoseconds(ticks stamp);
+
+    static bool usingTsc() { return tscEnabled; }
+    static double ticksPerNanosecond();
+
+private:
+    struct Calibration
+    {
+        ticks baseTicks = 0;
+        int64_t baseMonotonicNs = 0;
+        int64_t baseRealtimeNs = 0;
+        ticks lastTicks = 0;
+        int64_t lastMonotonicNs = 0;
+    };
+
+    static bool tscEnabled;
+    static atomic<double> nanosecondsPerTick;
+    static atomic<int64_t> recalibrationIntervalNs;
+    static atomic<int64_t> nextRecalibrationNs;
+    static mutex calibrationMutex;
+    static Calibration calibration;
+
+    static ticks steadyNanoseconds()
+    {
+        return static_cast<ticks>(chrono::duration_cast<chrono::nanoseconds>(
+                                      chrono::steady_clock::now().time_since_epoch())
+                                      .count());
+    }
+    static bool detectInvariantTsc();
+};
+
+#endif